@@ -0,0 +1,7 @@
+benchRoute.o: benchRoute.cpp ../route/routeMgr.h ../route/routeNet.h \
+ ../route/routeDef.h ../route/routeHash.h ../route/routeHeap.h \
+ ../route/routeCache.h ../../include/util.h ../../include/rnGen.h \
+ ../../include/myUsage.h
+genCase.o: genCase.cpp
+hashBench.o: hashBench.cpp ../route/routeNet.h ../route/routeDef.h \
+ ../route/routeHash.h
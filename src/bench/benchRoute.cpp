@@ -0,0 +1,133 @@
+/****************************************************************************
+  FileName     [ benchRoute.cpp ]
+  PackageName  [ bench ]
+  Synopsis     [ End-to-end benchmark of the router phases ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../route/routeMgr.h"
+#include "util.h"
+
+using namespace std;
+
+extern RouteMgr* routeMgr;
+
+// Every case runs in its own child process so that peak RSS is per case
+// and the router's log can be discarded.
+struct BenchResult
+{
+   bool     ok;
+   double   load, reroute, precise, write;
+   unsigned initWL, bestWL, overflow;
+};
+
+static double
+since(chrono::steady_clock::time_point t)
+{
+   return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+static BenchResult
+runCase(const char* fileName, unsigned seed)
+{
+   BenchResult res;
+   memset(&res, 0, sizeof(res));
+   rnGen.reset(seed);
+
+   auto t = chrono::steady_clock::now();
+   routeMgr = new RouteMgr();
+   if (!routeMgr->readCircuit(fileName)) return res;
+   res.load = since(t);
+   res.initWL = routeMgr->getBestWL();
+
+   t = chrono::steady_clock::now();
+   routeMgr->reroute();
+   res.reroute = since(t);
+
+   t = chrono::steady_clock::now();
+   routeMgr->precisePnR(0);
+   res.precise = since(t);
+
+   // The best result is formatted whenever it changes, so only the write
+   // of the published buffer is left
+   t = chrono::steady_clock::now();
+   ofstream devNull("/dev/null");
+   routeMgr->writeCircuit(devNull);
+   devNull.close();
+   res.write = since(t);
+
+   res.bestWL = routeMgr->getBestWL();
+   res.overflow = routeMgr->getOverflowCnt();
+   res.ok = true;
+   return res;
+}
+
+int
+main(int argc, char** argv)
+{
+   unsigned seed = 0;
+   vector<const char*> cases;
+   for (int i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = atoi(argv[++i]);
+      else cases.push_back(argv[i]);
+   }
+   if (cases.empty()) {
+      cerr << "Usage: benchRoute [-seed <n>] <case.txt>..." << endl;
+      return 1;
+   }
+
+   cout << setw(24) << left << "case" << right
+        << setw(10) << "load(s)" << setw(10) << "reroute" << setw(10) << "precise"
+        << setw(10) << "write" << setw(12) << "RSS(MB)" << setw(10) << "initWL"
+        << setw(10) << "finalWL" << setw(10) << "overflow" << endl;
+   for (auto fileName : cases) {
+      int fds[2];
+      if (pipe(fds) != 0) return 1;
+      cout.flush();
+      pid_t pid = fork();
+      if (pid == 0) {
+         close(fds[0]);
+         int devNull = open("/dev/null", O_WRONLY);
+         dup2(devNull, STDOUT_FILENO);
+         BenchResult res = runCase(fileName, seed);
+         cout.flush();
+         ssize_t n = write(fds[1], &res, sizeof(res));
+         _exit(n == sizeof(res) ? 0 : 1);
+      }
+      close(fds[1]);
+      BenchResult res;
+      bool got = (pid > 0 && read(fds[0], &res, sizeof(res)) == sizeof(res));
+      close(fds[0]);
+      struct rusage usage;
+      int status = 0;
+      if (pid > 0) wait4(pid, &status, 0, &usage);
+
+      string name = fileName;
+      size_t slash = name.find_last_of('/');
+      if (slash != string::npos) name = name.substr(slash + 1);
+      cout << setw(24) << left << name << right;
+      if (!got || !res.ok) {
+         cout << "  failed" << endl;
+         continue;
+      }
+      cout << fixed << setprecision(3)
+           << setw(10) << res.load << setw(10) << res.reroute << setw(10) << res.precise
+           << setw(10) << res.write << setw(12) << setprecision(1) << usage.ru_maxrss / 1024.0
+           << setw(10) << res.initWL << setw(10) << res.bestWL << setw(10) << res.overflow << endl;
+   }
+   return 0;
+}
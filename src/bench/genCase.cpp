@@ -0,0 +1,278 @@
+/****************************************************************************
+  FileName     [ genCase.cpp ]
+  PackageName  [ bench ]
+  Synopsis     [ Synthetic cell-move-router case generator ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+// Writes a case in the format RouteMgr::readCircuit() parses, with a legal
+// initial route for every net, so the router can be timed on grids and
+// netlists far larger than public_cases.
+//
+// Layers alternate H/V starting with M1 = H. All pins sit on M1; nets
+// without constraint are routed H on M1 and V on M2, nets with min layer
+// M2 are routed H on M3 and V on M2.
+//
+// The demand of the initial routes, blockages and neighbor rules is counted
+// per gGrid, and the supply of a layer is raised above its peak demand, so
+// that the case starts without overflow.
+
+#define MC_NUM          16
+#define DEFAULT_SUPPLY  100
+#define SUPPLY_SLACK    10  // % of supply kept free on the busiest gGrid
+
+static uint64_t seed = 1;
+
+static unsigned
+nextRand(unsigned range)
+{
+   seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+   return (unsigned)((seed >> 33) % range);
+}
+
+struct GenMC
+{
+   unsigned pinCnt;
+   vector<pair<unsigned, unsigned>> blkgs; // <layer, demand>
+};
+
+struct GenCell
+{
+   unsigned mc, row, col;
+   uint8_t  usedPins; // bit i: pin i+1 already on a net
+};
+
+struct GenSeg
+{
+   unsigned r1, c1, l1, r2, c2, l2, net;
+};
+
+static void
+connect(vector<GenSeg>& segs, const GenCell& a, const GenCell& b,
+        unsigned hLay, unsigned vLay, unsigned net)
+{
+   if (a.row == b.row && a.col == b.col) return;
+   unsigned lay = 1;
+   if (a.col != b.col) {
+      if (hLay != lay) segs.push_back({a.row, a.col, lay, a.row, a.col, hLay, net});
+      segs.push_back({a.row, a.col, hLay, a.row, b.col, hLay, net});
+      lay = hLay;
+   }
+   if (a.row != b.row) {
+      if (vLay != lay) segs.push_back({a.row, b.col, lay, a.row, b.col, vLay, net});
+      segs.push_back({a.row, b.col, vLay, b.row, b.col, vLay, net});
+      lay = vLay;
+   }
+   if (lay != 1) segs.push_back({b.row, b.col, lay, b.row, b.col, 1, net});
+}
+
+static inline size_t
+gridKey(unsigned row, unsigned col, unsigned lay, unsigned cols, unsigned layCnt)
+{
+   return ((size_t)(row - 1) * cols + (col - 1)) * layCnt + (lay - 1);
+}
+
+// Like the router, a net adds 1 to every gGrid layer its segments or pins
+// cover, however many times it covers it
+static void
+addNetDemand(vector<unsigned>& demand, vector<size_t>& keys, const GenSeg* beg,
+             const GenSeg* end, const vector<GenCell>& cells,
+             const vector<pair<unsigned, unsigned>>& pins, unsigned cols, unsigned layCnt)
+{
+   keys.clear();
+   for (auto& pin : pins)
+      keys.push_back(gridKey(cells[pin.first].row, cells[pin.first].col, 1, cols, layCnt));
+   for (const GenSeg* s = beg; s != end; ++s) {
+      unsigned p[3] = { s->r1, s->c1, s->l1 };
+      const unsigned e[3] = { s->r2, s->c2, s->l2 };
+      keys.push_back(gridKey(p[0], p[1], p[2], cols, layCnt));
+      for (unsigned d = 0; d < 3; ++d) {
+         while (p[d] != e[d]) {
+            p[d] += (p[d] < e[d]) ? 1 : -1;
+            keys.push_back(gridKey(p[0], p[1], p[2], cols, layCnt));
+         }
+      }
+   }
+   sort(keys.begin(), keys.end());
+   keys.erase(unique(keys.begin(), keys.end()), keys.end());
+   for (auto key : keys) ++demand[key];
+}
+
+static void
+usage()
+{
+   cerr << "Usage: genCase <rows> <cols> <layers> <cells> <nets> [seed] > case.txt" << endl;
+   exit(-1);
+}
+
+int
+main(int argc, char** argv)
+{
+   if (argc < 6 || argc > 7) usage();
+   unsigned rows = atoi(argv[1]), cols = atoi(argv[2]), layCnt = atoi(argv[3]);
+   unsigned cellCnt = atoi(argv[4]), netCnt = atoi(argv[5]);
+   if (argc == 7) seed = strtoull(argv[6], 0, 10);
+   if (rows < 2 || cols < 2 || layCnt < 2 || cellCnt < 2) usage();
+
+   // Master cells
+   vector<GenMC> mcs(MC_NUM);
+   for (auto& mc : mcs) {
+      mc.pinCnt = 2 + nextRand(3);
+      unsigned blkgCnt = nextRand(3);
+      for (unsigned j = 0; j < blkgCnt; ++j)
+         mc.blkgs.push_back(make_pair(1 + nextRand(layCnt), 1 + nextRand(3)));
+   }
+
+   // Cell instances
+   vector<GenCell> cells(cellCnt);
+   for (auto& c : cells) {
+      c.mc = nextRand(MC_NUM);
+      c.row = 1 + nextRand(rows);
+      c.col = 1 + nextRand(cols);
+      c.usedPins = 0;
+   }
+
+   // Nets: every pin belongs to at most one net
+   vector<vector<pair<unsigned, unsigned>>> nets; // <cell, pin>
+   vector<bool> constrained;
+   nets.reserve(netCnt);
+   for (unsigned fails = 0; nets.size() < netCnt && fails < 1000; ) {
+      unsigned pinCnt = 2 + (nextRand(4) ? nextRand(2) : nextRand(4));
+      vector<pair<unsigned, unsigned>> pins;
+      for (unsigned tries = 0; pins.size() < pinCnt && tries < 8 * pinCnt; ++tries) {
+         unsigned c = nextRand(cellCnt);
+         unsigned p = nextRand(mcs[cells[c].mc].pinCnt);
+         if (cells[c].usedPins & (1 << p)) continue;
+         cells[c].usedPins |= (1 << p);
+         pins.push_back(make_pair(c, p));
+      }
+      if (pins.size() < 2) {
+         // Pins are running out, give up after many misses in a row
+         for (auto& pin : pins) cells[pin.first].usedPins &= ~(1 << pin.second);
+         ++fails;
+         continue;
+      }
+      fails = 0;
+      nets.push_back(pins);
+      constrained.push_back(layCnt >= 3 && nextRand(20) == 0);
+   }
+
+   // Initial routes: a chain through the pins of each net
+   vector<unsigned> demand((size_t)rows * cols * layCnt, 0);
+   vector<size_t> keys;
+   vector<GenSeg> segs;
+   for (unsigned i = 0; i < nets.size(); ++i) {
+      unsigned hLay = constrained[i] ? 3 : 1;
+      size_t first = segs.size();
+      for (unsigned j = 1; j < nets[i].size(); ++j)
+         connect(segs, cells[nets[i][j-1].first], cells[nets[i][j].first], hLay, 2, i + 1);
+      addNetDemand(demand, keys, segs.data() + first, segs.data() + segs.size(), cells,
+                   nets[i], cols, layCnt);
+   }
+
+   // Blockages, and the sameGGrid/adjHGGrid rules between MC1 and MC2 on M1
+   vector<unsigned> mc1Cnt((size_t)rows * cols, 0), mc2Cnt((size_t)rows * cols, 0);
+   for (auto& c : cells) {
+      for (auto& blkg : mcs[c.mc].blkgs)
+         demand[gridKey(c.row, c.col, blkg.first, cols, layCnt)] += blkg.second;
+      if (c.mc == 0) ++mc1Cnt[(size_t)(c.row - 1) * cols + (c.col - 1)];
+      if (c.mc == 1) ++mc2Cnt[(size_t)(c.row - 1) * cols + (c.col - 1)];
+   }
+   for (unsigned r = 1; r <= rows; ++r) {
+      for (unsigned c = 1; c <= cols; ++c) {
+         size_t g = (size_t)(r - 1) * cols + (c - 1);
+         unsigned extra = 2 * min(mc1Cnt[g], mc2Cnt[g]);
+         if (c > 1)
+            extra += min(mc1Cnt[g], mc2Cnt[g-1]) + min(mc2Cnt[g], mc1Cnt[g-1]);
+         if (c < cols)
+            extra += min(mc1Cnt[g], mc2Cnt[g+1]) + min(mc2Cnt[g], mc1Cnt[g+1]);
+         demand[gridKey(r, c, 1, cols, layCnt)] += extra;
+      }
+   }
+
+   // Supply: the peak demand of a layer plus SUPPLY_SLACK, at least DEFAULT_SUPPLY
+   vector<unsigned> laySupply(layCnt, 0);
+   for (size_t key = 0; key < demand.size(); ++key)
+      laySupply[key % layCnt] = max(laySupply[key % layCnt], demand[key]);
+   for (auto& supply : laySupply)
+      supply = max((unsigned)DEFAULT_SUPPLY, supply + supply * SUPPLY_SLACK / 100 + 1);
+
+   // Non-default supply: one entry per gGrid layer, never cut below its demand
+   unordered_map<size_t, int> ndSupply;
+   vector<pair<size_t, int>> ndList;
+   unsigned ndCnt = rows * cols / 100;
+   for (unsigned i = 0, tries = 0; i < ndCnt && tries < 8 * ndCnt; ++tries) {
+      unsigned r = 1 + nextRand(rows), c = 1 + nextRand(cols), l = 1 + nextRand(layCnt);
+      size_t key = gridKey(r, c, l, cols, layCnt);
+      if (ndSupply.count(key)) continue;
+      int delta = 1 + nextRand(laySupply[l-1] / 10);
+      if (nextRand(2)) delta = -min(delta, (int)(laySupply[l-1] - demand[key]));
+      if (delta == 0) continue;
+      ndSupply[key] = delta;
+      ndList.push_back(make_pair(key, delta));
+      ++i;
+   }
+
+   // Never emit a case that overflows before any cell moves
+   for (size_t key = 0; key < demand.size(); ++key) {
+      auto it = ndSupply.find(key);
+      int supply = laySupply[key % layCnt] + (it == ndSupply.end() ? 0 : it->second);
+      if ((int)demand[key] > supply) {
+         size_t g = key / layCnt;
+         cerr << "Error: gGrid(" << g / cols + 1 << "," << g % cols + 1 << "," << key % layCnt + 1
+              << ") overflows, supply " << supply << " demand " << demand[key] << "!!" << endl;
+         return 1;
+      }
+   }
+
+   // Output
+   static char buf[1 << 20];
+   setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+   printf("MaxCellMove %u\n", cellCnt / 10 + 1);
+   printf("GGridBoundaryIdx 1 1 %u %u\n", rows, cols);
+   printf("NumLayer %u\n", layCnt);
+   for (unsigned l = 1; l <= layCnt; ++l)
+      printf("Lay M%u %u %c %u\n", l, l, (l % 2) ? 'H' : 'V', laySupply[l-1]);
+   printf("NumNonDefaultSupplyGGrid %u\n", (unsigned)ndList.size());
+   for (auto& nd : ndList) {
+      size_t g = nd.first / layCnt;
+      printf("%u %u %u %c%d\n", (unsigned)(g / cols + 1), (unsigned)(g % cols + 1),
+             (unsigned)(nd.first % layCnt + 1), nd.second > 0 ? '+' : '-', abs(nd.second));
+   }
+   printf("NumMasterCell %u\n", MC_NUM);
+   for (unsigned i = 0; i < MC_NUM; ++i) {
+      printf("MasterCell MC%u %u %u\n", i + 1, mcs[i].pinCnt, (unsigned)mcs[i].blkgs.size());
+      for (unsigned j = 0; j < mcs[i].pinCnt; ++j)
+         printf("Pin P%u M1\n", j + 1);
+      for (unsigned j = 0; j < mcs[i].blkgs.size(); ++j)
+         printf("Blkg B%u M%u %u\n", j + 1, mcs[i].blkgs[j].first, mcs[i].blkgs[j].second);
+   }
+   printf("NumNeighborCellExtraDemand 2\n");
+   printf("sameGGrid MC1 MC2 M1 2\n");
+   printf("adjHGGrid MC1 MC2 M1 1\n");
+   printf("NumCellInst %u\n", cellCnt);
+   for (unsigned i = 0; i < cellCnt; ++i)
+      printf("CellInst C%u MC%u %u %u %s\n", i + 1, cells[i].mc + 1, cells[i].row, cells[i].col,
+             (i % 10) ? "Movable" : "Fixed");
+   printf("NumNets %u\n", (unsigned)nets.size());
+   for (unsigned i = 0; i < nets.size(); ++i) {
+      printf("Net N%u %u %s\n", i + 1, (unsigned)nets[i].size(), constrained[i] ? "M2" : "NoCstr");
+      for (auto& pin : nets[i])
+         printf("Pin C%u/P%u\n", pin.first + 1, pin.second + 1);
+   }
+   printf("NumRoutes %u\n", (unsigned)segs.size());
+   for (auto& s : segs)
+      printf("%u %u %u %u %u %u N%u\n", s.r1, s.c1, s.l1, s.r2, s.c2, s.l2, s.net);
+   return 0;
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+  FileName     [ hashBench.cpp ]
+  PackageName  [ bench ]
+  Synopsis     [ Microbenchmark of MCTri keyed table lookups ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include <cstdlib>
+#include "../route/routeNet.h"
+
+using namespace std;
+
+// The hasher RouteMgr used before FlatHashMap, kept for comparison
+struct LegacyTriHash{
+  size_t operator()(const MCTri& p) const{
+    return ((p.idx1 << 13)+(p.idx2 << 27)+p.layNum);
+  }
+};
+
+static unsigned
+nextRand(unsigned long long& s)
+{
+   s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+   return (unsigned)(s >> 33);
+}
+
+// Same access pattern as RouteMgr::addNeighborDemand(): one probe per
+// layer for a pair of MCs, most of them missing
+template <class Map>
+static double
+probe(const Map& m, const vector<MCTri>& queries, unsigned& hits)
+{
+   auto t0 = chrono::steady_clock::now();
+   hits = 0;
+   for (auto& q : queries)
+      if (m.find(q) != m.end()) ++hits;
+   auto t1 = chrono::steady_clock::now();
+   return chrono::duration<double>(t1 - t0).count();
+}
+
+static void
+report(const char* name, double sec, size_t n, unsigned hits)
+{
+   cout << setw(24) << left << name
+        << setw(12) << right << fixed << setprecision(2)
+        << (n / sec / 1e6) << " M lookups/s   (" << hits << " hits)" << endl;
+}
+
+int
+main(int argc, char** argv)
+{
+   unsigned mcCnt = 5000, layCnt = 10, entryCnt = 200000;
+   unsigned queryCnt = 5000000;
+   if (argc > 1) mcCnt = atoi(argv[1]);
+   if (argc > 2) entryCnt = atoi(argv[2]);
+
+   unsigned long long seed = 1;
+   vector<MCTri> keys, queries;
+   for (unsigned i = 0; i < entryCnt; ++i)
+      keys.push_back(MCTri(nextRand(seed) % mcCnt + 1, nextRand(seed) % mcCnt + 1,
+                           nextRand(seed) % layCnt + 1));
+   for (unsigned i = 0; i < queryCnt; ++i) {
+      if (i % 4 == 0) queries.push_back(keys[nextRand(seed) % keys.size()]);
+      else queries.push_back(MCTri(nextRand(seed) % mcCnt + 1, nextRand(seed) % mcCnt + 1,
+                                   nextRand(seed) % layCnt + 1));
+   }
+
+   unordered_map<MCTri, unsigned, LegacyTriHash> legacy;
+   unordered_map<MCTri, unsigned, TriHash> mixed;
+   MCTriMap flat;
+   for (unsigned i = 0; i < keys.size(); ++i) {
+      legacy.insert(pair<MCTri, unsigned>(keys[i], i));
+      mixed.insert(pair<MCTri, unsigned>(keys[i], i));
+      flat.insert(pair<MCTri, unsigned>(keys[i], i));
+   }
+
+   cout << "MC count " << mcCnt << ", entries " << flat.size()
+        << ", lookups " << queries.size() << endl;
+   unsigned hits;
+   double sec = probe(legacy, queries, hits);
+   report("unordered_map(legacy)", sec, queries.size(), hits);
+   sec = probe(mixed, queries, hits);
+   report("unordered_map(TriHash)", sec, queries.size(), hits);
+   sec = probe(flat, queries, hits);
+   report("MCTriMap", sec, queries.size(), hits);
+   return 0;
+}
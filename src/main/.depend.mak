@@ -1,4 +1,5 @@
 main.o: main.cpp ../../include/util.h ../../include/rnGen.h \
  ../../include/myUsage.h ../../include/cmdParser.h \
  ../../include/cmdCharDef.h ../route/routeMgr.h ../route/routeNet.h \
- ../route/routeDef.h
+ ../route/routeDef.h ../route/routeHash.h ../route/routeHeap.h \
+ ../route/routeCache.h ../route/routeProf.h
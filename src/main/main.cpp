@@ -9,12 +9,16 @@
 #include "util.h"
 #include "cmdParser.h"
 #include "../route/routeMgr.h"
+#include "../route/routeProf.h"
 #include <cassert>
 #include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
 #define TIME_LIMIT 3600
+#define TIME_RESERVE 60 // left for writing the output
 
 //----------------------------------------------------------------------
 //    Global cmd Manager
@@ -24,21 +28,31 @@ CmdParser* cmdMgr = new CmdParser("route> ");
 extern bool initCommonCmd();
 extern bool initRouteCmd();
 
-ofstream outfile;
+static int outFd = -1;
 extern RouteMgr *routeMgr;
 
+// Only async-signal-safe calls here: the best result is kept serialized,
+// so dumping it is a plain write(2) on the pre-opened output file
 static void signal_handler(int signum){
-   //cout << "Time limit exceeded!!" << endl;
-   cout << "\nOutput file ... \n";
-   routeMgr->writeCircuit(outfile);
-   myUsage.report(true, true);
-   exit(0);
+   static const char msg[] = "\nOutput file ... \n";
+   ssize_t ret = write(STDOUT_FILENO, msg, sizeof(msg) - 1);
+   (void)ret;
+   if (routeMgr) {
+      routeMgr->dumpBest(outFd);
+      routeMgr->abortPortfolio();
+   }
+   _exit(0);
 }
 
 static void
 usage()
 {
-   cout << "Usage: ./cell_move_router [ < inputFile > < outputFile > ]" << endl;
+   cout << "Usage: ./cell_move_router [ [--resume < checkpointFile >] [--profile < jsonFile >]"
+        << " [--seed < number >] [--batch < cellCount >]"
+        << " [--route3d < viaCost >] [--jobs < workerCount >] [--portfolio < workerCount >]"
+        << " [--bidir < minDist >] [--coarse < tileSize >]"
+        << " [--skipslack < gGrids >] [--routecache < entryCount >] < inputFile > < outputFile > ]" << endl
+        << "       ./cell_move_router --verify < inputFile > < outputFile >" << endl;
 }
 
 static void
@@ -55,6 +69,67 @@ main(int argc, char** argv)
 
    ifstream dof;
 
+   string resumeFile, profFile;
+   unsigned long long seed = 0;
+   unsigned batch = 1;
+   double viaCost = -1; // < 0: no 3D maze routing
+   unsigned jobs = 1;
+   unsigned portfolio = 1;
+   unsigned bidir = 0;
+   unsigned coarse = 0;
+   unsigned skipSlack = 0;
+   unsigned routeCache = 0;
+   while (argc > 3) {
+      string opt = argv[1];
+      if (opt == "--resume")  // --resume < checkpointFile >
+         resumeFile = argv[2];
+      else if (opt == "--profile")  // --profile < jsonFile >
+         profFile = argv[2];
+      else if (opt == "--seed")  // --seed < number >
+         seed = strtoull(argv[2], 0, 10);
+      else if (opt == "--batch")  // --batch < cellCount >
+         batch = strtoul(argv[2], 0, 10);
+      else if (opt == "--route3d")  // --route3d < viaCost >
+         viaCost = strtod(argv[2], 0);
+      else if (opt == "--jobs")  // --jobs < workerCount >
+         jobs = strtoul(argv[2], 0, 10);
+      else if (opt == "--portfolio")  // --portfolio < workerCount >
+         portfolio = strtoul(argv[2], 0, 10);
+      else if (opt == "--bidir")  // --bidir < minDist >
+         bidir = strtoul(argv[2], 0, 10);
+      else if (opt == "--coarse")  // --coarse < tileSize >
+         coarse = strtoul(argv[2], 0, 10);
+      else if (opt == "--skipslack")  // --skipslack < gGrids >
+         skipSlack = strtoul(argv[2], 0, 10);
+      else if (opt == "--routecache")  // --routecache < entryCount >
+         routeCache = strtoul(argv[2], 0, 10);
+      else break;
+      argv += 2; argc -= 2;
+   }
+   routeProf.enable(!profFile.empty() || argc == 1);
+   rnGen.reset(seed);
+
+   if (argc == 4 && string(argv[1]) == "--verify") {  // --verify < inputFile > < outputFile >
+      routeMgr = new RouteMgr();
+      if (!routeMgr->readCircuit(argv[2]))
+         return 1;
+      unsigned inWL = 0, outWL = 0;
+      bool inValid = routeMgr->verify(&inWL);
+      cout << "Total gGrid length: " << inWL << "\n"
+           << (inValid ? "<----     Input  Valid!    ---->" : "<----     Input Invalid!   ---->") << "\n";
+      if (!routeMgr->readOutput(argv[3])) {
+         cout << "<---- Read Output Failed!  ---->" << endl;
+         return 1;
+      }
+      bool outValid = routeMgr->verify(&outWL);
+      cout << "Total gGrid length: " << outWL << "\n"
+           << (outValid ? "<----    Output Valid!     ---->" : "<----    Output Invalid!   ---->") << "\n";
+      if (outValid)
+         cout << "Final score (reduced gGrid length) " << inWL << " - " << outWL << " = "
+              << (int)inWL - (int)outWL << "\n";
+      return outValid ? 0 : 1;
+   }
+
    if (argc == 3) {  // < inputFile > < outputFile >
       // TODO: handle input file instead of cmd dofile
       /*
@@ -68,8 +143,8 @@ main(int argc, char** argv)
       cout << "time: " << std::ctime(&time);
       #endif
       
-      outfile.open(argv[2], ios::out);
-      if (!outfile) {
+      outFd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (outFd < 0) {
          cerr << "Output file open fail!" << endl;
          return 1;
       }
@@ -89,21 +164,29 @@ main(int argc, char** argv)
       string outFileName = argv[2];
       routeMgr->readCircuit(inputFile);
       routeMgr->printInputSummary();
+      if (!resumeFile.empty() && !routeMgr->readCheckpoint(resumeFile))
+         return 1;
+      routeMgr->setCheckpoint(outFileName + ".ckpt");
       
-      routeMgr->reroute();
-      routeMgr->reroute();
-      if(routeMgr->getCellCnt() > 100){
-         routeMgr->precisePnR(0);
-         routeMgr->precisePnR(0);
-         routeMgr->reroute();
-         routeMgr->precisePnR(0);
-         routeMgr->precisePnR(0);
-      }
-      //routeMgr->reroute();
-      else{
-         routeMgr->mainPnR();
+      routeMgr->setTimeBudget(TIME_LIMIT - TIME_RESERVE);
+      routeMgr->setPlaceBatch(batch);
+      if (viaCost >= 0) routeMgr->setRoute3D(viaCost);
+      routeMgr->setJobs(jobs);
+      routeMgr->setBidir(bidir);
+      routeMgr->setCoarse(coarse);
+      routeMgr->setSkipSlack(skipSlack);
+      routeMgr->setRouteCache(routeCache);
+      routeMgr->schedulePortfolio(portfolio, outFileName);
+      cout.flush();
+      alarm(0);   // the SIGALRM dump must not fire on a closed outFd
+      bool dumped = routeMgr->dumpBest(outFd);
+      close(outFd);
+      if (dumped) routeMgr->removeCheckpoint();
+      else routeMgr->waitCheckpoint();
+      if (!profFile.empty()) {
+         ofstream profOut(profFile.c_str());
+         routeProf.writeJson(profOut);
       }
-      routeMgr->writeCircuit(outfile);
       
       #ifdef DEBUG
       std::time_t time_2 = std::time(0);
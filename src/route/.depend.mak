@@ -1,14 +1,40 @@
-routeMgr.o: routeMgr.cpp routeMgr.h routeNet.h routeDef.h ../util/util.h \
- ../util/rnGen.h ../util/myUsage.h
-routePrint.o: routePrint.cpp routeMgr.h routeNet.h routeDef.h \
- ../util/util.h ../util/rnGen.h ../util/myUsage.h
-routeCmd.o: routeCmd.cpp routeMgr.h routeNet.h routeDef.h routeCmd.h \
- ../../include/cmdParser.h ../../include/cmdCharDef.h \
+routeAnneal.o: routeAnneal.cpp routeMgr.h routeNet.h routeDef.h \
+ routeHash.h routeHeap.h routeCache.h routeProf.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h
+routeCkpt.o: routeCkpt.cpp routeMgr.h routeNet.h routeDef.h routeHash.h \
+ routeHeap.h routeCache.h
+routeCmd.o: routeCmd.cpp routeMgr.h routeNet.h routeDef.h routeHash.h \
+ routeHeap.h routeCache.h routeCmd.h ../../include/cmdParser.h \
+ ../../include/cmdCharDef.h routeProf.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h
+routeCoarse.o: routeCoarse.cpp routeMgr.h routeNet.h routeDef.h \
+ routeHash.h routeHeap.h routeCache.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h
+routeMaze.o: routeMaze.cpp routeMgr.h routeNet.h routeDef.h routeHash.h \
+ routeHeap.h routeCache.h routeProf.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h
+routeMgr.o: routeMgr.cpp routeMgr.h routeNet.h routeDef.h routeHash.h \
+ routeHeap.h routeCache.h routeProf.h ../util/util.h ../util/rnGen.h \
+ ../util/myUsage.h
+routeNet.o: routeNet.cpp routeNet.h routeDef.h routeHash.h routeMgr.h \
+ routeHeap.h routeCache.h
+routeOpt.o: routeOpt.cpp routeMgr.h routeNet.h routeDef.h routeHash.h \
+ routeHeap.h routeCache.h routeProf.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h stlastar.h fsa.h
+routePortfolio.o: routePortfolio.cpp routeMgr.h routeNet.h routeDef.h \
+ routeHash.h routeHeap.h routeCache.h ../../include/rnGen.h \
  ../../include/util.h ../../include/rnGen.h ../../include/myUsage.h
-routeOpt.o: routeOpt.cpp routeMgr.h routeNet.h routeDef.h \
- ../../include/util.h ../../include/rnGen.h ../../include/myUsage.h \
- stlastar.h fsa.h
+routePrint.o: routePrint.cpp routeMgr.h routeNet.h routeDef.h routeHash.h \
+ routeHeap.h routeCache.h ../util/util.h ../util/rnGen.h \
+ ../util/myUsage.h
+routeProf.o: routeProf.cpp routeProf.h
+routeRegion.o: routeRegion.cpp routeMgr.h routeNet.h routeDef.h \
+ routeHash.h routeHeap.h routeCache.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h
 routeRoute.o: routeRoute.cpp routeRoute.h stlastar.h fsa.h routeMgr.h \
- routeNet.h routeDef.h ../../include/util.h ../../include/rnGen.h \
- ../../include/myUsage.h
-routeNet.o: routeNet.cpp routeNet.h routeDef.h routeMgr.h
+ routeNet.h routeDef.h routeHash.h routeHeap.h routeCache.h \
+ ../../include/util.h ../../include/rnGen.h ../../include/myUsage.h \
+ routeProf.h
+routeVerify.o: routeVerify.cpp routeMgr.h routeNet.h routeDef.h \
+ routeHash.h routeHeap.h routeCache.h ../../include/util.h \
+ ../../include/rnGen.h ../../include/myUsage.h
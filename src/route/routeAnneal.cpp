@@ -0,0 +1,396 @@
+/****************************************************************************
+  FileName     [ routeAnneal.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define simulated-annealing global placement ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include "routeMgr.h"
+#include "routeProf.h"
+#include "util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+#define ANNEAL_TIME_RATIO   0.25  // share of the remaining time given to annealing
+#define ANNEAL_CELL_TIME    0.05  // at most this many seconds per movable cell
+#define ANNEAL_MAX_TIME     300.0
+#define ANNEAL_MIN_TIME     0.1
+#define ANNEAL_PERIODS      4     // the best placement is routed at the end of each period
+#define ANNEAL_INIT_ACCEPT  0.2   // uphill acceptance ratio at the initial temperature
+#define ANNEAL_FINAL_TEMP   1e-3  // final temperature relative to the initial one
+#define ANNEAL_CONG_WEIGHT  2.0   // cost of a fully used gGrid, in gGrid lengths
+#define ANNEAL_CROWD_WEIGHT 1.0   // cost of k cells piled into a gGrid is weight * (k-1)^2
+#define ANNEAL_RESTORE_PROB 10    // percent of moves that send a moved cell home
+#define ANNEAL_COMMIT_CELLS 8     // cells moved and rerouted together when committing
+#define ANNEAL_CHECK_MOVES  256   // moves between two clock reads
+
+static inline double
+uniform01()
+{
+    return (rnGen.next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Shadow placement the annealer works on. Nothing in RouteMgr is touched
+// until a period ends, so a move costs O(pins of the nets of the cell).
+struct AnnealState
+{
+    vector<Pos>              pos;       // cell idx -> current position
+    vector<Pos>              realPos;   // cell idx -> position in RouteMgr
+    vector<vector<unsigned>> cellNets;  // cell idx -> distinct net idx
+    vector<vector<unsigned>> netCells;  // net idx -> distinct cell idx
+    vector<unsigned>         netHPWL;   // net idx -> half perimeter + 1
+    vector<double>           gridPen;   // (row-1)*cEnd+(col-1) -> congestion cost
+    vector<bool>             gridFull;  // gGrid already overflowed
+    vector<int>              crowd;     // gGrid -> cells gained since the start
+    vector<unsigned>         movable;   // candidate cell idx
+    vector<unsigned>         moved;     // cell idx away from the initial position
+    vector<unsigned>         movedIdx;  // cell idx -> index in moved
+    vector<unsigned>         touched;   // cell idx whose pos may differ from realPos
+    vector<bool>             isTouched;
+    double                   cost;
+
+    unsigned hpwl(unsigned net, unsigned cell, Pos p) const {
+        unsigned rMin = UINT_MAX, rMax = 0, cMin = UINT_MAX, cMax = 0;
+        for (auto c : netCells[net]) {
+            const Pos& q = (c == cell) ? p : pos[c];
+            rMin = min(rMin, q.first);  rMax = max(rMax, q.first);
+            cMin = min(cMin, q.second); cMax = max(cMax, q.second);
+        }
+        return (rMax - rMin) + (cMax - cMin) + 1;
+    }
+    static unsigned gridIdx(Pos p) { return (p.first-1) * Ggrid::cEnd + (p.second-1); }
+    static double crowdCost(int k) { return k > 1 ? ANNEAL_CROWD_WEIGHT * (k-1) * (k-1) : 0; }
+    double pen(Pos p) const { return gridPen[gridIdx(p)]; }
+    bool full(Pos p) const { return gridFull[gridIdx(p)]; }
+    // Grid-dependent cost change of moving one cell
+    double gridDelta(Pos from, Pos to) const {
+        int kf = crowd[gridIdx(from)], kt = crowd[gridIdx(to)];
+        return pen(to) - pen(from) + crowdCost(kf-1) - crowdCost(kf) + crowdCost(kt+1) - crowdCost(kt);
+    }
+    void touch(unsigned c) {
+        if (!isTouched[c]) { isTouched[c] = true; touched.push_back(c); }
+    }
+};
+
+/*************************************/
+/*   class RouteMgr member functions */
+/*************************************/
+bool
+RouteMgr::scheduleAnneal()
+{
+    unsigned movableCnt = 0;
+    for (auto cell : _instList)
+        if (cell->is_movable() && !cell->min_layer_constraint) ++movableCnt;
+    double slice = min(getRemainingTime() * ANNEAL_TIME_RATIO, ANNEAL_MAX_TIME);
+    slice = min(slice, movableCnt * ANNEAL_CELL_TIME);
+    if (timeUp() || slice < ANNEAL_MIN_TIME) {
+        cout << "Skip annealing, slice " << slice << " s, remaining " << getRemainingTime() << " s\n";
+        return false;
+    }
+    return annealPlace(slice);
+}
+
+// Simulated annealing over cell positions. The cost is the half perimeter
+// of every net plus a penalty for crowded gGrids, MaxCellMove is never
+// exceeded, and the temperature decays exponentially with the wall-clock
+// share of the slice. Only the best placement of each period is routed,
+// whole and then in small chunks, and a batch is kept only if the routed
+// WL beats the best solution.
+bool
+RouteMgr::annealPlace(double seconds)
+{
+    PROF_SCOPE(PROF_ANNEAL);
+    cout << "\nAnnealing placement for " << seconds << " s...\n";
+    AnnealState st;
+    unsigned cellCnt = _instList.size();
+    st.pos.resize(cellCnt);
+    st.cellNets.resize(cellCnt);
+    st.netCells.resize(_netList.size());
+    st.movedIdx.assign(cellCnt, UINT_MAX);
+    st.isTouched.assign(cellCnt, false);
+    for (unsigned i=0; i<cellCnt; ++i) {
+        CellInst* cell = _instList[i];
+        st.pos[i] = cell->getPos();
+        if (st.pos[i] != cell->getInitPos()) {
+            st.movedIdx[i] = st.moved.size();
+            st.moved.push_back(i);
+        }
+        if (cell->is_movable() && !cell->min_layer_constraint)
+            st.movable.push_back(i);
+    }
+    st.realPos = st.pos;
+    if (st.movable.empty()) return false;
+    for (unsigned n=0; n<_netList.size(); ++n) {
+        for (auto& cellPair : _netList[n]->_assoCellInstMap) {
+            st.netCells[n].push_back(cellPair.first - 1);
+            st.cellNets[cellPair.first - 1].push_back(n);
+        }
+    }
+    st.cost = 0;
+    st.netHPWL.resize(_netList.size());
+    for (unsigned n=0; n<_netList.size(); ++n) {
+        st.netHPWL[n] = st.netCells[n].empty() ? 1 : st.hpwl(n, UINT_MAX, Pos(0, 0));
+        st.cost += st.netHPWL[n];
+    }
+    st.gridPen.resize(Ggrid::rEnd * Ggrid::cEnd);
+    st.gridFull.resize(Ggrid::rEnd * Ggrid::cEnd);
+    st.crowd.assign(Ggrid::rEnd * Ggrid::cEnd, 0);
+    for (unsigned i=1; i<=Ggrid::rEnd; ++i) {
+        for (unsigned j=1; j<=Ggrid::cEnd; ++j) {
+            Ggrid* g = _gridList[i-1][j-1];
+            st.gridPen[(i-1) * Ggrid::cEnd + (j-1)] = ANNEAL_CONG_WEIGHT * max(0.0, 1.0 - g->get2dCongestion());
+            st.gridFull[(i-1) * Ggrid::cEnd + (j-1)] = g->getOverflowCount() != 0;
+        }
+    }
+    for (auto c : st.movable) st.cost += st.pen(st.pos[c]);
+
+    // One move: a random movable cell goes near the center of its nets or
+    // near where it is, or a moved cell goes home
+    unsigned span = max(Ggrid::rEnd - Ggrid::rBeg, Ggrid::cEnd - Ggrid::cBeg) + 1;
+    double radius = span;
+    auto propose = [&](unsigned& cell, Pos& to) -> bool {
+        if (!st.moved.empty() && (int)rnGen(100) < ANNEAL_RESTORE_PROB) {
+            cell = st.moved[rnGen(st.moved.size())];
+            if (!_instList[cell]->is_movable() || _instList[cell]->min_layer_constraint) return false;
+            to = _instList[cell]->getInitPos();
+            return true;
+        }
+        cell = st.movable[rnGen(st.movable.size())];
+        Pos center = st.pos[cell];
+        if (rnGen(2)) {
+            unsigned rSum = 0, cSum = 0, cnt = 0;
+            for (auto n : st.cellNets[cell])
+                for (auto c : st.netCells[n])
+                    if (c != cell) { rSum += st.pos[c].first; cSum += st.pos[c].second; ++cnt; }
+            if (cnt) center = Pos((rSum + cnt/2) / cnt, (cSum + cnt/2) / cnt);
+        }
+        int r = max(1, (int)radius);
+        int row = (int)center.first + rnGen(2*r + 1) - r;
+        int col = (int)center.second + rnGen(2*r + 1) - r;
+        row = max((int)Ggrid::rBeg, min((int)Ggrid::rEnd, row));
+        col = max((int)Ggrid::cBeg, min((int)Ggrid::cEnd, col));
+        to = Pos(row, col);
+        return true;
+    };
+    // Cost change of moving cell to p, or false if the move is illegal
+    auto delta = [&](unsigned cell, Pos p, double& d) -> bool {
+        if (p == st.pos[cell] || st.full(p)) return false;
+        Pos init = _instList[cell]->getInitPos();
+        if (st.pos[cell] == init && p != init && st.moved.size() >= _maxMoveCnt) return false;
+        d = st.gridDelta(st.pos[cell], p);
+        for (auto n : st.cellNets[cell])
+            d += (double)st.hpwl(n, cell, p) - st.netHPWL[n];
+        return true;
+    };
+    auto apply = [&](unsigned cell, Pos p) {
+        Pos init = _instList[cell]->getInitPos();
+        bool wasMoved = (st.pos[cell] != init);
+        st.cost += st.gridDelta(st.pos[cell], p);
+        --st.crowd[st.gridIdx(st.pos[cell])];
+        ++st.crowd[st.gridIdx(p)];
+        st.pos[cell] = p;
+        for (auto n : st.cellNets[cell]) {
+            unsigned w = st.hpwl(n, UINT_MAX, p);
+            st.cost += (double)w - st.netHPWL[n];
+            st.netHPWL[n] = w;
+        }
+        if (wasMoved && p == init) {
+            unsigned idx = st.movedIdx[cell];
+            st.moved[idx] = st.moved.back();
+            st.movedIdx[st.moved[idx]] = idx;
+            st.moved.pop_back();
+            st.movedIdx[cell] = UINT_MAX;
+        }
+        else if (!wasMoved && p != init) {
+            st.movedIdx[cell] = st.moved.size();
+            st.moved.push_back(cell);
+        }
+        st.touch(cell);
+    };
+
+    // Initial temperature from the average uphill step
+    double upSum = 0;
+    unsigned upCnt = 0;
+    for (unsigned i=0; i<4 * st.movable.size() && upCnt < 200; ++i) {
+        unsigned cell; Pos p; double d;
+        if (propose(cell, p) && delta(cell, p, d) && d > 0) { upSum += d; ++upCnt; }
+    }
+    double t0 = upCnt ? -(upSum / upCnt) / log(ANNEAL_INIT_ACCEPT) : 1.0;
+    double temp = t0;
+
+    double start = getElapsedTime();
+    double committedCost = st.cost, bestCost = st.cost;
+    vector<pair<unsigned,Pos>> bestMoves; // touched cells at the best cost
+    bool improved = false;
+    unsigned long long moveCnt = 0, acceptCnt = 0;
+    for (unsigned period=1; period<=ANNEAL_PERIODS; ++period) {
+        double periodEnd = start + seconds * period / ANNEAL_PERIODS;
+        while (true) {
+            if (moveCnt % ANNEAL_CHECK_MOVES == 0) {
+                double now = getElapsedTime();
+                if (now >= periodEnd || timeUp()) break;
+                double frac = (now - start) / seconds;
+                temp = t0 * pow(ANNEAL_FINAL_TEMP, frac);
+                radius = max(1.0, span * temp / t0);
+                if (st.cost < bestCost - 1e-9) {
+                    bestCost = st.cost;
+                    bestMoves.clear();
+                    for (auto c : st.touched) bestMoves.push_back(make_pair(c, st.pos[c]));
+                }
+            }
+            ++moveCnt;
+            unsigned cell; Pos p; double d;
+            if (!propose(cell, p) || !delta(cell, p, d)) continue;
+            if (d <= 0 || uniform01() < exp(-d / temp)) {
+                apply(cell, p);
+                ++acceptCnt;
+            }
+        }
+        if (st.cost < bestCost - 1e-9) {
+            bestCost = st.cost;
+            bestMoves.clear();
+            for (auto c : st.touched) bestMoves.push_back(make_pair(c, st.pos[c]));
+        }
+        #ifdef DEBUG
+        cout << "Anneal period " << period << ": T " << temp << ", cost " << st.cost
+             << ", best " << bestCost << ", moved " << st.moved.size() << "\n";
+        #endif
+        if (bestCost >= committedCost - 1e-9) {
+            if (timeUp()) break;
+            continue;
+        }
+
+        // Route the best placement of this period as a whole, then a few
+        // cells at a time; a batch that does not route or does not shorten
+        // WL is undone
+        vector<pair<CellInst*,Pos>> moves;
+        for (auto& m : bestMoves)
+            if (m.second != st.realPos[m.first]) moves.push_back(make_pair(_instList[m.first], m.second));
+        routeProf.count(PROF_ANNEAL_COMMIT);
+        if (commitPlacement(moves)) {
+            for (auto& m : moves) st.realPos[m.first->getId()-1] = m.second;
+            improved = true;
+            moves.clear();
+        }
+        for (unsigned i=0; moves.size() > ANNEAL_COMMIT_CELLS && i<moves.size() && !timeUp();
+             i+=ANNEAL_COMMIT_CELLS) {
+            vector<pair<CellInst*,Pos>> chunk(moves.begin() + i,
+                moves.begin() + min((size_t)i + ANNEAL_COMMIT_CELLS, moves.size()));
+            routeProf.count(PROF_ANNEAL_COMMIT);
+            if (!commitPlacement(chunk)) continue;
+            for (auto& m : chunk) st.realPos[m.first->getId()-1] = m.second;
+            improved = true;
+        }
+        // Restart from the routed placement
+        for (auto c : st.touched) if (st.pos[c] != st.realPos[c]) apply(c, st.realPos[c]);
+        bestCost = committedCost = st.cost;
+        vector<unsigned> stillTouched;
+        for (auto c : st.touched) {
+            if (st.pos[c] != st.realPos[c]) stillTouched.push_back(c);
+            else st.isTouched[c] = false;
+        }
+        st.touched.swap(stillTouched);
+        bestMoves.clear();
+        if (timeUp()) break;
+    }
+    routeProf.count(PROF_ANNEAL_MOVES, moveCnt);
+    routeProf.count(PROF_ANNEAL_ACCEPT, acceptCnt);
+    cout << "Annealing done: " << moveCnt << " moves, " << acceptCnt << " accepted, best WL "
+         << _bestTotalWL << "\n";
+    return improved;
+}
+
+// Move a batch of cells and reroute their nets. The result is kept and
+// stored as the best if the routed WL is better; otherwise cells, routes
+// and demand are put back. Unlike route(), the nets are routed here so
+// that a net whose 2D route failed (and got no 3D demand) is known.
+bool
+RouteMgr::commitPlacement(const vector<pair<CellInst*,Pos>>& moves)
+{
+    vector<Net*> nets;
+    for (auto& m : moves) {
+        for (auto id : m.first->assoNet) {
+            Net* n = _netList[id-1];
+            if (n->_toRemoveDemand) continue;
+            n->_toRemoveDemand = true;
+            nets.push_back(n);
+        }
+    }
+    vector< vector<Segment> > origSegs(nets.size());
+    for (unsigned i=0; i<nets.size(); ++i) {
+        Net* n = nets[i];
+        n->_toRemoveDemand = false;
+        for (auto s : n->_netSegs) origSegs[i].push_back(*s);
+        remove2DDemand(n);
+        remove3DDemand(n);
+        n->ripUp();
+    }
+    vector<Pos> origPos;
+    for (auto& m : moves) {
+        origPos.push_back(m.first->getPos());
+        relocateCell(m.first, m.second);
+    }
+
+    // A chunk may move cells without the chunk that sends others home, and
+    // blockage or neighbor demand may overflow a gGrid no net is routed on
+    bool canRoute = getCurMoveCnt() <= _maxMoveCnt;
+    for (unsigned i=0; i<moves.size() && canRoute; ++i) {
+        Pos p = moves[i].second;
+        for (unsigned c=max(p.second, Ggrid::cBeg+1)-1; c<=min(p.second+1, Ggrid::cEnd) && canRoute; ++c)
+            if (_gridList[p.first-1][c-1]->getOverflowCount()) canRoute = false;
+    }
+
+    // Stop at the first failure, the batch is rejected anyway
+    unsigned assigned = 0; // nets[0, assigned) carry 3D demand
+    for (unsigned i=0; i<nets.size() && canRoute; ++i) {
+        Net* n = nets[i];
+        if (route2D(n) == ROUTE_EXEC_ERROR) { canRoute = false; break; }
+        ++assigned;
+        if (layerassign(n) == ROUTE_EXEC_ERROR) { canRoute = false; break; }
+    }
+    for (unsigned i=0; i<assigned && canRoute; ++i)
+        if (nets[i]->checkOverflow()) canRoute = false;
+    unsigned newWL = canRoute ? evaluateWireLen() : UINT_MAX;
+    #ifdef DEBUG
+    cout << "Anneal commit " << moves.size() << " cells, " << nets.size() << " nets: WL " << newWL
+         << " (best " << _bestTotalWL << ")\n";
+    #endif
+    if (newWL < _bestTotalWL) {
+        for (auto n : nets) { n->_routable = true; n->shouldReroute(false); }
+        _netRank->update();
+        replaceBest();
+        return true;
+    }
+
+    for (unsigned i=0; i<nets.size(); ++i) {
+        Net* n = nets[i];
+        if (i < assigned) remove3DDemand(n);
+        if (!n->_netSegs.empty()) remove2DDemand(n);
+        n->ripUp();
+    }
+    for (unsigned i=moves.size(); i-- > 0; )
+        relocateCell(moves[i].first, origPos[i]);
+    for (unsigned i=0; i<nets.size(); ++i) {
+        Net* n = nets[i];
+        n->shouldReroute(false);
+        for (auto& s : origSegs[i])
+            n->_netSegs.push_back(new Segment(s));
+        add3DDemand(n);
+        add2DDemand(n);
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+/****************************************************************************
+  FileName     [ routeCache.h ]
+  PackageName  [ route ]
+  Synopsis     [ Define the LRU cache of net routes by pin geometry ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef ROUTE_CACHE_H
+#define ROUTE_CACHE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include "routeNet.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------
+//    RouteCache
+//----------------------------------------------------------------------
+// A route of a net for one placement of its pins
+struct RouteCacheEntry
+{
+    uint64_t        key;
+    unsigned        netId;
+    vector<unsigned> pins; // (row, col, layer) of every pin
+    vector<Segment> segs;
+    unsigned        wl;
+};
+
+// Bounded LRU map from the pin geometry of a net to its route. The key is
+// a hash of the net ID and the pins; an entry also keeps the pins, so a
+// colliding key is a miss. Capacity 0 disables the cache.
+class RouteCache
+{
+public:
+    RouteCache() : _capacity(0) {}
+
+    void setCapacity(unsigned capacity) { _capacity = capacity; clear(); }
+    unsigned capacity() const { return _capacity; }
+    unsigned size() const { return _lru.size(); }
+    void clear() { _lru.clear(); _map.clear(); }
+
+    // The entry of the net with these pins, made the most recent one
+    const RouteCacheEntry* find(uint64_t key, unsigned netId, const vector<unsigned>& pins) {
+        auto it = _map.find(key);
+        if (it == _map.end()) return 0;
+        if (it->second->netId != netId || it->second->pins != pins) return 0;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return &_lru.front();
+    }
+    void insert(uint64_t key, unsigned netId, const vector<unsigned>& pins,
+                const vector<Segment*>& segs, unsigned wl) {
+        if (!_capacity) return;
+        erase(key);
+        if (_lru.size() >= _capacity) {
+            _map.erase(_lru.back().key);
+            _lru.pop_back();
+        }
+        _lru.push_front(RouteCacheEntry());
+        RouteCacheEntry& e = _lru.front();
+        e.key = key;
+        e.netId = netId;
+        e.pins = pins;
+        for (auto s : segs) e.segs.push_back(*s);
+        e.wl = wl;
+        _map[key] = _lru.begin();
+    }
+    void erase(uint64_t key) {
+        auto it = _map.find(key);
+        if (it == _map.end()) return;
+        _lru.erase(it->second);
+        _map.erase(it);
+    }
+
+private:
+    unsigned                    _capacity;
+    list<RouteCacheEntry>       _lru; // most recent first
+    unordered_map<uint64_t, list<RouteCacheEntry>::iterator> _map;
+};
+
+#endif // ROUTE_CACHE_H
@@ -0,0 +1,340 @@
+/****************************************************************************
+  FileName     [ routeCkpt.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define binary checkpoint/restore of the solution state ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unistd.h>
+#include <csignal>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "routeMgr.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+#define CKPT_INTERVAL 60  // seconds between two snapshots
+
+// File layout (native endian, all counts are uint32):
+//   header  : magic, version, rEnd, cEnd, layCnt, cellCnt, netCnt
+//   cells   : row, col of every cell, then the moved cell ids
+//   nets    : segment count and segments of every net
+//   demand  : 3D demand of every layer in the pool, 2D demand of every gGrid
+//   rank    : NetRank <netId, WL> pairs
+//   best    : best WL, whether the best is the input solution, then the
+//             best moved cells and route segments (none if it is)
+static const char     ckptMagic[8] = { 'A', 'M', 'V', 'C', 'K', 'P', 'T', '\0' };
+static const uint32_t ckptVersion  = 2;
+
+template <class T> static inline void
+writePod(ostream& os, const T& v) { os.write((const char*)&v, sizeof(T)); }
+
+template <class T> static inline bool
+readPod(istream& is, T& v) { return (bool)is.read((char*)&v, sizeof(T)); }
+
+static inline void
+writeSeg(ostream& os, const Segment& s)
+{
+    for (unsigned i=0; i<3; ++i) writePod(os, (uint32_t)s.startPos[i]);
+    for (unsigned i=0; i<3; ++i) writePod(os, (uint32_t)s.endPos[i]);
+}
+
+// Whether cnt records of size bytes can still be read from is; a count
+// past the end of the file marks is failed rather than being allocated
+static inline bool
+fitsInFile(istream& is, streamoff fileSize, uint32_t cnt, size_t size)
+{
+    if (!is) return false;
+    streamoff left = fileSize - (streamoff)is.tellg();
+    if ((uint64_t)cnt * size > (uint64_t)max(left, (streamoff)0)) {
+        is.setstate(ios::failbit);
+        return false;
+    }
+    return true;
+}
+
+static inline bool
+readSeg(istream& is, Segment& s)
+{
+    uint32_t v;
+    for (unsigned i=0; i<3; ++i) { if (!readPod(is, v)) return false; s.startPos[i] = v; }
+    for (unsigned i=0; i<3; ++i) { if (!readPod(is, v)) return false; s.endPos[i] = v; }
+    return true;
+}
+
+/**********************************************/
+/*   class RouteMgr member functions          */
+/**********************************************/
+bool
+RouteMgr::writeCheckpoint(const string& fileName) const
+{
+    ofstream ofs(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!ofs) return false;
+
+    ofs.write(ckptMagic, sizeof(ckptMagic));
+    writePod(ofs, ckptVersion);
+    writePod(ofs, (uint32_t)Ggrid::rEnd);
+    writePod(ofs, (uint32_t)Ggrid::cEnd);
+    writePod(ofs, (uint32_t)_laySupply.size());
+    writePod(ofs, (uint32_t)_instList.size());
+    writePod(ofs, (uint32_t)_netList.size());
+
+    // Cells
+    for (auto cell : _instList) {
+        Pos pos = cell->getPos();
+        writePod(ofs, (uint32_t)pos.first);
+        writePod(ofs, (uint32_t)pos.second);
+    }
+    writePod(ofs, (uint32_t)_curMovedSet.size());
+    for (auto cell : _curMovedSet)
+        writePod(ofs, (uint32_t)cell->getId());
+
+    // Nets
+    for (auto net : _netList) {
+        writePod(ofs, (uint32_t)net->_netSegs.size());
+        for (auto seg : net->_netSegs)
+            writeSeg(ofs, *seg);
+    }
+
+    // Demand
+    for (auto& lay : _layerPool)
+        writePod(ofs, (int32_t)lay.getDemand());
+    for (auto& rows : _gridList)
+        for (auto g : rows)
+            writePod(ofs, g->get2dDemand());
+
+    // NetRank
+    writePod(ofs, (uint32_t)_netRank->NetWLpairs.size());
+    for (auto& nwPair : _netRank->NetWLpairs) {
+        writePod(ofs, (uint32_t)nwPair.first);
+        writePod(ofs, (uint32_t)nwPair.second);
+    }
+
+    // Best-so-far
+    writePod(ofs, (uint32_t)_bestTotalWL);
+    writePod(ofs, (uint32_t)_bestIsInit);
+    writePod(ofs, (uint32_t)_bestMovedCells.size());
+    for (auto& m : _bestMovedCells) {
+        writePod(ofs, (uint32_t)get<0>(m));
+        writePod(ofs, (uint32_t)get<1>(m));
+        writePod(ofs, (uint32_t)get<2>(m));
+    }
+    writePod(ofs, (uint32_t)_bestRouteSegs.size());
+    for (auto& s : _bestRouteSegs) {
+        writeSeg(ofs, s.first);
+        writePod(ofs, (uint32_t)s.second);
+    }
+
+    ofs.close();
+    return !ofs.fail();
+}
+
+// Must be called right after readCircuit() on the same input file
+bool
+RouteMgr::readCheckpoint(const string& fileName)
+{
+    ifstream ifs(fileName.c_str(), ios::in | ios::binary);
+    if (!ifs) {
+        cerr << "Error: checkpoint \"" << fileName << "\" does not exist!!" << endl;
+        return false;
+    }
+
+    ifs.seekg(0, ios::end);
+    streamoff fileSize = ifs.tellg();
+    ifs.seekg(0, ios::beg);
+
+    char magic[sizeof(ckptMagic)];
+    uint32_t version, rEnd, cEnd, layCnt, cellCnt, netCnt;
+    if (!ifs.read(magic, sizeof(magic)) || memcmp(magic, ckptMagic, sizeof(magic)) != 0
+        || !readPod(ifs, version) || version != ckptVersion) {
+        cerr << "Error: \"" << fileName << "\" is not a checkpoint file!!" << endl;
+        return false;
+    }
+    readPod(ifs, rEnd); readPod(ifs, cEnd); readPod(ifs, layCnt);
+    readPod(ifs, cellCnt); readPod(ifs, netCnt);
+    if (!ifs || rEnd != Ggrid::rEnd || cEnd != Ggrid::cEnd || layCnt != _laySupply.size()
+        || cellCnt != _instList.size() || netCnt != _netList.size()) {
+        cerr << "Error: checkpoint \"" << fileName << "\" does not match the input!!" << endl;
+        return false;
+    }
+
+    // Decode everything first so that a truncated file leaves RouteMgr untouched
+    vector<Pos> cellPos(cellCnt);
+    for (auto& pos : cellPos) {
+        uint32_t r, c;
+        readPod(ifs, r); readPod(ifs, c);
+        if (r < Ggrid::rBeg || r > rEnd || c < Ggrid::cBeg || c > cEnd) {
+            ifs.setstate(ios::failbit); break;
+        }
+        pos = Pos(r, c);
+    }
+    uint32_t cnt = 0;
+    readPod(ifs, cnt);
+    if (cnt > cellCnt) ifs.setstate(ios::failbit);
+    vector<uint32_t> movedIds(ifs ? cnt : 0);
+    for (auto& id : movedIds) {
+        readPod(ifs, id);
+        if (id == 0 || id > cellCnt) { ifs.setstate(ios::failbit); break; }
+    }
+    vector<vector<Segment>> netSegs(netCnt);
+    for (unsigned i=0; ifs && i<netCnt; ++i) {
+        if (!readPod(ifs, cnt) || !fitsInFile(ifs, fileSize, cnt, 6 * sizeof(uint32_t))) break;
+        netSegs[i].resize(cnt);
+        for (auto& s : netSegs[i])
+            if (!readSeg(ifs, s)) break;
+    }
+    vector<int32_t> layDemand(ifs ? _layerPool.size() : 0);
+    for (auto& d : layDemand) readPod(ifs, d);
+    vector<double> gridDemand(ifs ? rEnd * cEnd : 0);
+    for (auto& d : gridDemand) readPod(ifs, d);
+    readPod(ifs, cnt);
+    if (cnt > netCnt) ifs.setstate(ios::failbit);
+    vector<PinPair> rank(ifs ? cnt : 0);
+    for (auto& nwPair : rank) {
+        uint32_t id, wl;
+        readPod(ifs, id); readPod(ifs, wl);
+        nwPair = PinPair(id, wl);
+    }
+    uint32_t bestWL = 0, bestIsInit = 0;
+    readPod(ifs, bestWL);
+    readPod(ifs, bestIsInit);
+    readPod(ifs, cnt);
+    if (cnt > cellCnt) ifs.setstate(ios::failbit);
+    vector<OutputCell> bestCells(ifs ? cnt : 0);
+    for (auto& m : bestCells) {
+        uint32_t id, r, c;
+        readPod(ifs, id); readPod(ifs, r); readPod(ifs, c);
+        m = OutputCell(id, r, c);
+    }
+    readPod(ifs, cnt);
+    fitsInFile(ifs, fileSize, cnt, 7 * sizeof(uint32_t));
+    vector<OutputSeg> bestSegs(ifs ? cnt : 0);
+    for (auto& s : bestSegs) {
+        uint32_t netId = 0;
+        readSeg(ifs, s.first); readPod(ifs, netId);
+        s.second = netId;
+    }
+    if (!ifs) {
+        cerr << "Error: checkpoint \"" << fileName << "\" is truncated!!" << endl;
+        return false;
+    }
+
+    // Cells
+    for (unsigned i=0; i<cellCnt; ++i) {
+        CellInst* cell = _instList[i];
+        if (cell->getPos() == cellPos[i]) continue;
+        vector<CellInst*>& oldList = cell->getGrid()->cellInstList;
+        for (unsigned j=0; j<oldList.size(); ++j) {
+            if (oldList[j] == cell) { oldList.erase(oldList.begin() + j); break; }
+        }
+        cell->move(cellPos[i]);
+        cell->getGrid()->cellInstList.push_back(cell);
+    }
+    _curMovedSet.clear();
+    for (auto id : movedIds)
+        _curMovedSet.insert(_instList[id-1]);
+
+    // Nets
+    for (unsigned i=0; i<netCnt; ++i) {
+        Net* n = _netList[i];
+        n->ripUp();
+        for (auto& s : netSegs[i])
+            n->_netSegs.push_back(new Segment(s.startPos[0], s.startPos[1], s.startPos[2],
+                                              s.endPos[0], s.endPos[1], s.endPos[2]));
+    }
+
+    // Demand
+    for (size_t i=0; i<_layerPool.size(); ++i)
+        _layerPool[i].setDemand(layDemand[i]);
+    for (unsigned i=0; i<rEnd; ++i)
+        for (unsigned j=0; j<cEnd; ++j)
+            _gridList[i][j]->set2dDemand(gridDemand[i*cEnd + j]);
+
+    _netRank->load(rank);
+    _bestTotalWL = bestWL;
+    // The input solution was serialized by readCircuit() before the nets changed
+    if (!bestIsInit) {
+        _bestIsInit = false;
+        _bestMovedCells.swap(bestCells);
+        _bestRouteSegs.swap(bestSegs);
+        serializeBest();
+    }
+
+    cout << "Resume from checkpoint \"" << fileName << "\", best WL " << _bestTotalWL << "\n";
+    return true;
+}
+
+// Write a snapshot from a forked child so the optimizer never waits for the
+// disk. The child sees a copy-on-write image of the current state, writes it
+// to a temporary file and renames it, so a crash never leaves a torn file.
+void
+RouteMgr::saveCheckpoint(bool force)
+{
+    if (_ckptFile.empty()) return;
+    if (_ckptPid > 0) {
+        if (waitpid(_ckptPid, NULL, WNOHANG) == 0) return; // previous one still writing
+        _ckptPid = 0;
+    }
+    time_t now = time(0);
+    if (!force && now - _lastCkptTime < CKPT_INTERVAL) return;
+    _lastCkptTime = now;
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Leave the emergency output to the parent
+        signal(SIGINT, SIG_DFL);
+        signal(SIGSEGV, SIG_DFL);
+        string tmpFile = _ckptFile + ".tmp";
+        int ret = 1;
+        if (writeCheckpoint(tmpFile) && rename(tmpFile.c_str(), _ckptFile.c_str()) == 0)
+            ret = 0;
+        _exit(ret);
+    }
+    else if (pid > 0) {
+        _ckptPid = pid;
+        #ifdef DEBUG
+        cout << "Checkpoint process " << pid << " started\n";
+        #endif
+    }
+    else {
+        // fork failed, write in place rather than losing the snapshot
+        string tmpFile = _ckptFile + ".tmp";
+        if (writeCheckpoint(tmpFile))
+            rename(tmpFile.c_str(), _ckptFile.c_str());
+    }
+}
+
+void
+RouteMgr::waitCheckpoint()
+{
+    if (_ckptPid > 0) {
+        waitpid(_ckptPid, NULL, 0);
+        _ckptPid = 0;
+    }
+}
+
+// The run ended with its output written, nothing is left to resume
+void
+RouteMgr::removeCheckpoint()
+{
+    if (_ckptFile.empty()) return;
+    waitCheckpoint();
+    unlink(_ckptFile.c_str());
+    unlink((_ckptFile + ".tmp").c_str());
+}
@@ -11,6 +11,7 @@
 #include <iomanip>
 #include "routeMgr.h"
 #include "routeCmd.h"
+#include "routeProf.h"
 #include "util.h"
 
 using namespace std;
@@ -332,7 +333,7 @@ RouteCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    Optimize < -All | -Overflow | -REroute | -2pinreroute | -Evaluate | -RAnk >
+//    Optimize < -All | -Overflow | -REroute | -2pinreroute | -Evaluate | -RAnk | -Verify >
 //----------------------------------------------------------------------
 CmdExecStatus
 OptimizeCmd::exec(const string& option)
@@ -364,6 +365,11 @@ OptimizeCmd::exec(const string& option)
       routeMgr->replaceBest();
    else if (myStrNCmp("-RAnk", token, 3) == 0)
       routeMgr->printRank();
+   else if (myStrNCmp("-Verify", token, 2) == 0) {
+      unsigned wl = 0;
+      bool valid = routeMgr->verify(&wl);
+      cout << "Total gGrid length: " << wl << (valid ? " (Valid)" : " (Invalid)") << endl;
+   }
    else 	
       return CmdExec::errorOption(CMD_OPT_ILLEGAL, token);
 
@@ -376,7 +382,7 @@ OptimizeCmd::exec(const string& option)
 void
 OptimizeCmd::usage(ostream& os) const
 {
-   os << "Usage: Optimize < -All | -Overflow | -REroute | -2pinreroute | -Evaluate | -RAnk >" << endl;
+   os << "Usage: Optimize < -All | -Overflow | -REroute | -2pinreroute | -Evaluate | -RAnk | -Verify >" << endl;
 }
 
 void
@@ -413,6 +419,8 @@ MgrPrintCmd::exec(const string& option)
       routeMgr->printExtraDemand();
    else if (myStrNCmp("-NOndefaultsupply", token, 3) == 0)
       routeMgr->printNonDefaultSupply();
+   else if (myStrNCmp("-Profile", token, 2) == 0)
+      routeProf.printReport();
    else if (myStrNCmp("-FECpairs", token, 4) == 0)
       cout << "routeMgr->printFECPairs()" << endl;
    else
@@ -425,7 +433,7 @@ void
 MgrPrintCmd::usage(ostream& os) const
 {  
    os << "Usage: MgrPrint [ -Summary | -Input |"
-      << " -Netlist | -MC | -Extra | -NOndefaultsupply ]\n";
+      << " -Netlist | -MC | -Extra | -NOndefaultsupply | -Profile ]\n";
 }
 
 void
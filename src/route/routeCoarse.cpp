@@ -0,0 +1,129 @@
+/****************************************************************************
+  FileName     [ routeCoarse.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define coarse-grid routing that bounds long connections ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <climits>
+#include <cfloat>
+#include "routeMgr.h"
+#include "util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+#define COARSE_CONG_WEIGHT  4.0 // extra cost of a tile at full utilization, in tile lengths
+#define CORRIDOR_HALO       1   // tiles kept around the coarse path
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+typedef pair<double,unsigned> CoarseEntry; // (f, tile idx)
+
+static inline unsigned
+tileDist(unsigned a, unsigned b)
+{
+    return a > b ? a - b : b - a;
+}
+
+/*************************************/
+/*   class RouteMgr member functions */
+/*************************************/
+// Aggregate the 3D supply and demand of every _coarseTile x _coarseTile
+// block of gGrids. Crossing a tile costs its side length, more when its
+// layers are used up; the costs are a snapshot, refreshed by route() and
+// reroute().
+void
+RouteMgr::buildCoarseGrid()
+{
+    if (!_coarseTile) return;
+    const unsigned k = _coarseTile, layCnt = _laySupply.size();
+    _coarseRows = (Ggrid::rEnd + k - 1) / k;
+    _coarseCols = (Ggrid::cEnd + k - 1) / k;
+    vector<double> supply(_coarseRows * _coarseCols, 0), demand(_coarseRows * _coarseCols, 0);
+    for (unsigned r=0; r<Ggrid::rEnd; ++r)
+        for (unsigned c=0; c<Ggrid::cEnd; ++c) {
+            unsigned t = (r / k) * _coarseCols + c / k;
+            const Layer* lay = &_layerPool[((size_t)r * Ggrid::cEnd + c) * layCnt];
+            for (unsigned l=0; l<layCnt; ++l) {
+                supply[t] += lay[l].getSupply();
+                demand[t] += lay[l].getDemand();
+            }
+        }
+    _coarseCost.resize(supply.size());
+    for (unsigned t=0; t<supply.size(); ++t)
+        _coarseCost[t] = k * (1 + COARSE_CONG_WEIGHT * (supply[t] > 0 ? demand[t] / supply[t] : 1));
+    if (_corridorMark.size() != supply.size()) {
+        _corridorMark.assign(supply.size(), 0);
+        _corridorRun = 0;
+    }
+}
+
+// A* over the tiles from the tiles of the sources to the tile of p2. The
+// tiles of the path, grown by CORRIDOR_HALO, become the corridor that
+// inRouteWindow() keeps the gGrid searches in until _corridorOn is reset.
+bool
+RouteMgr::setCorridor(const vector<Pos>& sources, Pos p2)
+{
+    const unsigned k = _coarseTile;
+    if (_coarseCost.empty()) buildCoarseGrid();
+    const unsigned tileCnt = _coarseRows * _coarseCols;
+    const unsigned tr = (p2.first-1) / k, tc = (p2.second-1) / k;
+    const unsigned target = tr * _coarseCols + tc;
+
+    vector<double> dist(tileCnt, DBL_MAX);
+    vector<unsigned> prev(tileCnt, UINT_MAX);
+    priority_queue<CoarseEntry, vector<CoarseEntry>, greater<CoarseEntry>> open;
+    for (auto& p : sources) {
+        unsigned t = ((p.first-1) / k) * _coarseCols + (p.second-1) / k;
+        if (dist[t] == 0) continue;
+        dist[t] = 0;
+        prev[t] = t;
+        open.push(CoarseEntry(k * (tileDist(t / _coarseCols, tr) + tileDist(t % _coarseCols, tc)), t));
+    }
+    while (!open.empty()) {
+        CoarseEntry top = open.top(); open.pop();
+        unsigned u = top.second;
+        if (u == target) break;
+        unsigned r = u / _coarseCols, c = u % _coarseCols;
+        if (top.first > dist[u] + k * (tileDist(r, tr) + tileDist(c, tc))) continue; // stale
+        const int dr[4] = { -1, 0, 1, 0 }, dc[4] = { 0, -1, 0, 1 };
+        for (unsigned i=0; i<4; ++i) {
+            unsigned nr = r + dr[i], nc = c + dc[i];
+            if (nr >= _coarseRows || nc >= _coarseCols) continue;
+            unsigned v = nr * _coarseCols + nc;
+            double d = dist[u] + _coarseCost[v];
+            if (d >= dist[v]) continue;
+            dist[v] = d;
+            prev[v] = u;
+            open.push(CoarseEntry(d + k * (tileDist(nr, tr) + tileDist(nc, tc)), v));
+        }
+    }
+    if (prev[target] == UINT_MAX) return false;
+
+    if (++_corridorRun == 0) { // stamps wrapped around
+        fill(_corridorMark.begin(), _corridorMark.end(), 0);
+        _corridorRun = 1;
+    }
+    for (unsigned t=target; ; t=prev[t]) {
+        unsigned r = t / _coarseCols, c = t % _coarseCols;
+        unsigned rLo = r > CORRIDOR_HALO ? r - CORRIDOR_HALO : 0, cLo = c > CORRIDOR_HALO ? c - CORRIDOR_HALO : 0;
+        unsigned rHi = min(r + CORRIDOR_HALO, _coarseRows - 1), cHi = min(c + CORRIDOR_HALO, _coarseCols - 1);
+        for (unsigned i=rLo; i<=rHi; ++i)
+            for (unsigned j=cLo; j<=cHi; ++j)
+                _corridorMark[i * _coarseCols + j] = _corridorRun;
+        if (prev[t] == t) break;
+    }
+    _corridorOn = true;
+    return true;
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+  FileName     [ routeHash.h ]
+  PackageName  [ route ]
+  Synopsis     [ Define hash mixer and open-addressing hash map ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef ROUTE_HASH_H
+#define ROUTE_HASH_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+//----------------------------------------------------------------------
+//    Hash mixer (splitmix64 finalizer)
+//----------------------------------------------------------------------
+// Every input bit affects every output bit, so keys that only differ in
+// their high bits (e.g. large MC ids) still spread over the whole table.
+inline size_t hashMix(uint64_t k)
+{
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return (size_t)k;
+}
+
+//----------------------------------------------------------------------
+//    FlatHashMap
+//----------------------------------------------------------------------
+// Open addressing with linear probing over a power-of-2 table.
+// Insert-only: the keyed tables of RouteMgr are filled while parsing and
+// only looked up afterwards, so erase is not supported.
+template <class Key, class Value, class Hash>
+class FlatHashMap
+{
+public:
+    typedef pair<Key, Value> Entry;
+
+    class iterator
+    {
+        friend FlatHashMap;
+    public:
+        iterator(const FlatHashMap* m = 0, size_t i = 0) : _map(m), _idx(i) { skip(); }
+        const Entry& operator * () const { return _map->_slots[_idx]; }
+        const Entry* operator -> () const { return &(_map->_slots[_idx]); }
+        iterator& operator ++ () { ++_idx; skip(); return *this; }
+        bool operator == (const iterator& i) const { return _idx == i._idx; }
+        bool operator != (const iterator& i) const { return _idx != i._idx; }
+    private:
+        void skip() {
+            if (!_map) return;
+            while (_idx < _map->_used.size() && !_map->_used[_idx]) ++_idx;
+        }
+        const FlatHashMap*  _map;
+        size_t              _idx;
+    };
+
+    FlatHashMap() : _size(0) { rehash(16); }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, _used.size()); }
+
+    void clear() {
+        _slots.clear(); _used.clear(); _size = 0;
+        rehash(16);
+    }
+
+    // Same semantics as unordered_map::insert: an existing key is kept
+    bool insert(const Entry& e) {
+        if ((_size + 1) * 4 > _used.size() * 3) rehash(_used.size() << 1);
+        size_t i = Hash()(e.first) & _mask;
+        while (_used[i]) {
+            if (_slots[i].first == e.first) return false;
+            i = (i + 1) & _mask;
+        }
+        _slots[i] = e;
+        _used[i] = 1;
+        ++_size;
+        return true;
+    }
+
+    iterator find(const Key& k) const {
+        size_t i = Hash()(k) & _mask;
+        while (_used[i]) {
+            if (_slots[i].first == k) return iterator(this, i);
+            i = (i + 1) & _mask;
+        }
+        return end();
+    }
+
+private:
+    void rehash(size_t cap) {
+        vector<Entry>   oldSlots;
+        vector<uint8_t> oldUsed;
+        oldSlots.swap(_slots);
+        oldUsed.swap(_used);
+        _slots.resize(cap);
+        _used.assign(cap, 0);
+        _mask = cap - 1;
+        _size = 0;
+        for (size_t i = 0; i < oldUsed.size(); ++i)
+            if (oldUsed[i]) insert(oldSlots[i]);
+    }
+
+    vector<Entry>       _slots;
+    vector<uint8_t>     _used;
+    size_t              _mask;
+    size_t              _size;
+};
+
+#endif // ROUTE_HASH_H
@@ -0,0 +1,106 @@
+/****************************************************************************
+  FileName     [ routeHeap.h ]
+  PackageName  [ route ]
+  Synopsis     [ Define indexed binary heap ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef ROUTE_HEAP_H
+#define ROUTE_HEAP_H
+
+#include <vector>
+#include <climits>
+#include <cassert>
+
+using namespace std;
+
+//----------------------------------------------------------------------
+//    IndexedHeap
+//----------------------------------------------------------------------
+// Min-heap over the ids [0, capacity) with a double key per id. Each id
+// knows its slot, so changing or erasing the key of an id is O(log N).
+// Equal keys are ordered by id, so the order does not depend on history.
+class IndexedHeap
+{
+public:
+    IndexedHeap() {}
+
+    void reset(unsigned capacity) {
+        _heap.clear();
+        _key.assign(capacity, 0);
+        _slot.assign(capacity, UINT_MAX);
+    }
+
+    unsigned size() const { return _heap.size(); }
+    bool empty() const { return _heap.empty(); }
+    bool contains(unsigned id) const { return id < _slot.size() && _slot[id] != UINT_MAX; }
+    unsigned top() const { assert(!_heap.empty()); return _heap[0]; }
+    double key(unsigned id) const { return _key[id]; }
+
+    void push(unsigned id, double k) {
+        assert(!contains(id));
+        _key[id] = k;
+        _slot[id] = _heap.size();
+        _heap.push_back(id);
+        up(_slot[id]);
+    }
+    void update(unsigned id, double k) {
+        assert(contains(id));
+        double old = _key[id];
+        _key[id] = k;
+        if (k < old) up(_slot[id]);
+        else if (k > old) down(_slot[id]);
+    }
+    void erase(unsigned id) {
+        assert(contains(id));
+        unsigned s = _slot[id];
+        unsigned last = _heap.back();
+        _heap.pop_back();
+        _slot[id] = UINT_MAX;
+        if (last == id) return;
+        _heap[s] = last;
+        _slot[last] = s;
+        up(s);
+        down(_slot[last]);
+    }
+    unsigned pop() {
+        unsigned id = top();
+        erase(id);
+        return id;
+    }
+
+private:
+    bool less(unsigned a, unsigned b) const {
+        return _key[a] < _key[b] || (_key[a] == _key[b] && a < b);
+    }
+    void place(unsigned s, unsigned id) { _heap[s] = id; _slot[id] = s; }
+    void up(unsigned s) {
+        unsigned id = _heap[s];
+        while (s > 0) {
+            unsigned p = (s - 1) >> 1;
+            if (!less(id, _heap[p])) break;
+            place(s, _heap[p]);
+            s = p;
+        }
+        place(s, id);
+    }
+    void down(unsigned s) {
+        unsigned id = _heap[s], n = _heap.size();
+        while (true) {
+            unsigned c = 2 * s + 1;
+            if (c >= n) break;
+            if (c + 1 < n && less(_heap[c + 1], _heap[c])) ++c;
+            if (!less(_heap[c], id)) break;
+            place(s, _heap[c]);
+            s = c;
+        }
+        place(s, id);
+    }
+
+    vector<unsigned>    _heap;  // slot -> id
+    vector<unsigned>    _slot;  // id -> slot, UINT_MAX if absent
+    vector<double>      _key;   // id -> key
+};
+
+#endif // ROUTE_HEAP_H
@@ -0,0 +1,189 @@
+/****************************************************************************
+  FileName     [ routeMaze.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define 3D maze routing over (row, col, layer) ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include "routeMgr.h"
+#include "routeProf.h"
+#include "util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+#define MAZE_MARGIN       5   // gGrids searched around the pin bounding box
+#define MAZE_CONG_WEIGHT  0.5 // cost of a gGrid at full utilization
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+typedef pair<double,unsigned> MazeEntry; // (f, gGrid idx)
+
+static inline unsigned
+mazeDist(unsigned a, unsigned b)
+{
+    return a > b ? a - b : b - a;
+}
+
+/*************************************/
+/*   class RouteMgr member functions */
+/*************************************/
+// Route a ripped-up net directly in 3D. Each pin is reached by one A* from
+// every gGrid already on the net, so the net grows as a tree. A move stays
+// in the layer direction and only on layers >= _minLayCons, a via goes up
+// or down anywhere, and a gGrid that one more net would overflow is never
+// entered. Each gGrid costs 1 (its wirelength), plus _viaCost for a via,
+// plus a congestion term; the Manhattan distance in 3D is the heuristic.
+// On success the net holds its segments with 2D and 3D demand added, the
+// 3D demand being what remove3DDemand() takes back; on failure it is left
+// empty with no demand.
+RouteExecStatus
+RouteMgr::route3D(Net* n)
+{
+    PROF_SCOPE(PROF_ROUTE3D);
+    const unsigned layCnt = _laySupply.size();
+    const unsigned cEnd = Ggrid::cEnd;
+    const unsigned minLay = n->getMinLayCons() ? n->getMinLayCons() : 1;
+    if (_mazeSeen.size() != _layerPool.size()) {
+        _mazeDist.assign(_layerPool.size(), 0);
+        _mazePrev.assign(_layerPool.size(), 0);
+        _mazeSeen.assign(_layerPool.size(), 0);
+        _mazeTree.assign(_layerPool.size(), false);
+        _mazeRun = 0;
+    }
+
+    // Pins and the search window
+    vector<unsigned> pins;
+    unsigned rMin = Ggrid::rEnd, rMax = Ggrid::rBeg, cMin = Ggrid::cEnd, cMax = Ggrid::cBeg;
+    for (auto& pin : n->_pinSet) {
+        Pos pos = getPinPos(pin);
+        pins.push_back(((pos.first-1) * cEnd + (pos.second-1)) * layCnt + (getPinLay(pin)-1));
+        rMin = min(rMin, pos.first);  rMax = max(rMax, pos.first);
+        cMin = min(cMin, pos.second); cMax = max(cMax, pos.second);
+    }
+    if (pins.empty()) return ROUTE_EXEC_DONE;
+    rMin = (rMin > Ggrid::rBeg + MAZE_MARGIN) ? rMin - MAZE_MARGIN : Ggrid::rBeg;
+    cMin = (cMin > Ggrid::cBeg + MAZE_MARGIN) ? cMin - MAZE_MARGIN : Ggrid::cBeg;
+    rMax = min(rMax + MAZE_MARGIN, Ggrid::rEnd);
+    cMax = min(cMax + MAZE_MARGIN, Ggrid::cEnd);
+    if (_routeWin.rEnd) {
+        rMin = max(rMin, _routeWin.rBeg); cMin = max(cMin, _routeWin.cBeg);
+        rMax = min(rMax, _routeWin.rEnd); cMax = min(cMax, _routeWin.cEnd);
+    }
+
+    // The gGrids on tree are skipped by the search, so no demand is added
+    // until the net is done
+    vector<unsigned> tree(1, pins[0]); // gGrids of the net
+    _mazeTree[pins[0]] = true;
+    bool failed = false;
+
+    priority_queue<MazeEntry, vector<MazeEntry>, greater<MazeEntry>> open;
+    for (unsigned p=1; p<pins.size() && !failed; ++p) {
+        unsigned target = pins[p];
+        if (_mazeTree[target]) continue;
+        // The first path leaves pins[0], one more net must fit there too
+        if (tree.size() == 1 && _layerPool[pins[0]].getDemand() >= (int)_layerPool[pins[0]].getSupply()) {
+            failed = true; break;
+        }
+        unsigned tl = target % layCnt, tc = (target / layCnt) % cEnd, tr = target / layCnt / cEnd;
+        if (++_mazeRun == 0) { // stamps wrapped around
+            fill(_mazeSeen.begin(), _mazeSeen.end(), 0);
+            _mazeRun = 1;
+        }
+        while (!open.empty()) open.pop();
+        for (auto g : tree) {
+            _mazeSeen[g] = _mazeRun;
+            _mazeDist[g] = 0;
+            _mazePrev[g] = g;
+            unsigned l = g % layCnt, c = (g / layCnt) % cEnd, r = g / layCnt / cEnd;
+            open.push(MazeEntry(mazeDist(r, tr) + mazeDist(c, tc) + mazeDist(l, tl), g));
+        }
+
+        bool found = false;
+        unsigned expanded = 0;
+        while (!open.empty()) {
+            MazeEntry top = open.top(); open.pop();
+            unsigned u = top.second;
+            unsigned l = u % layCnt, c = (u / layCnt) % cEnd, r = u / layCnt / cEnd;
+            double g = _mazeDist[u];
+            if (top.first > g + mazeDist(r, tr) + mazeDist(c, tc) + mazeDist(l, tl)) continue; // stale
+            ++expanded;
+            if (u == target) { found = true; break; }
+
+            // Neighbors in (row, col, layer), 0-based
+            unsigned next[4], via[4], cnt = 0;
+            if (l+1 >= minLay) {
+                if (_layDir[l]) { // H: column changes
+                    if (c+1 > cMin) { next[cnt] = u - layCnt; via[cnt++] = 0; }
+                    if (c+1 < cMax) { next[cnt] = u + layCnt; via[cnt++] = 0; }
+                } else {
+                    if (r+1 > rMin) { next[cnt] = u - cEnd * layCnt; via[cnt++] = 0; }
+                    if (r+1 < rMax) { next[cnt] = u + cEnd * layCnt; via[cnt++] = 0; }
+                }
+            }
+            if (l > 0)          { next[cnt] = u - 1; via[cnt++] = 1; }
+            if (l+1 < layCnt)   { next[cnt] = u + 1; via[cnt++] = 1; }
+
+            for (unsigned i=0; i<cnt; ++i) {
+                unsigned v = next[i];
+                if (_mazeTree[v]) continue;
+                const Layer& lay = _layerPool[v];
+                int demand = lay.getDemand();
+                if (demand >= (int)lay.getSupply()) continue; // one more net overflows
+                double cost = g + 1 + (via[i] ? _viaCost : 0)
+                            + MAZE_CONG_WEIGHT * (demand + 1) / lay.getSupply();
+                if (_mazeSeen[v] == _mazeRun && _mazeDist[v] <= cost) continue;
+                _mazeSeen[v] = _mazeRun;
+                _mazeDist[v] = cost;
+                _mazePrev[v] = u;
+                unsigned vl = v % layCnt, vc = (v / layCnt) % cEnd, vr = v / layCnt / cEnd;
+                open.push(MazeEntry(cost + mazeDist(vr, tr) + mazeDist(vc, tc) + mazeDist(vl, tl), v));
+            }
+        }
+        routeProf.count(PROF_ROUTE3D_EXPANDED, expanded);
+        if (!found) { failed = true; break; }
+
+        // Back-trace to the tree, one segment per straight run
+        vector<unsigned> path;
+        for (unsigned v=target; !_mazeTree[v]; v=_mazePrev[v]) path.push_back(v);
+        path.push_back(_mazePrev[path.back()]);
+        unsigned runBeg = 0;
+        for (unsigned i=1; i<path.size(); ++i) {
+            unsigned step = mazeDist(path[i], path[i-1]);
+            if (i+1 < path.size() && mazeDist(path[i+1], path[i]) == step) continue;
+            unsigned a = path[runBeg], b = path[i];
+            Segment* seg = new Segment(a / layCnt / cEnd + 1, (a / layCnt) % cEnd + 1, a % layCnt + 1,
+                                       b / layCnt / cEnd + 1, (b / layCnt) % cEnd + 1, b % layCnt + 1);
+            n->addSeg(seg);
+            runBeg = i;
+        }
+        for (unsigned i=0; i+1<path.size(); ++i) {
+            tree.push_back(path[i]);
+            _mazeTree[path[i]] = true;
+        }
+    }
+
+    for (auto g : tree) _mazeTree[g] = false;
+    if (failed) {
+        #ifdef DEBUG
+        cout << "route3D failed on Net N" << n->_netId << "\n";
+        #endif
+        routeProf.count(PROF_ROUTE3D_FAIL);
+        n->ripUp();
+        return ROUTE_EXEC_ERROR;
+    }
+    n->reduceSeg();
+    add2DDemand(n);
+    add3DDemand(n);
+    return ROUTE_EXEC_DONE;
+}
@@ -14,8 +14,11 @@
 #include <cassert>
 #include <cstring>
 #include <math.h>
+#include <cerrno>
+#include <unistd.h>
 #include "routeMgr.h"
 #include "routeNet.h"
+#include "routeProf.h"
 #include "../util/util.h"
 
 using namespace std;
@@ -51,6 +54,7 @@ RouteMgr::readCircuit(const string& fileName)
     unsigned bndCoord[4];
 
     // Start parsing
+    routeProf.start(PROF_READ_LAYERS);
     ifs >> buffer; // MaxCellMove
     ifs >> _maxMoveCnt; 
     ifs >> buffer; // GGridBoundaryIdx
@@ -62,6 +66,7 @@ RouteMgr::readCircuit(const string& fileName)
     ifs >> buffer; // NumLayers
     ifs >> tmpCnt; // LayerCount
     _laySupply.resize(tmpCnt);
+    _layDir.resize(tmpCnt);
     for(unsigned i=0; i<tmpCnt; ++i)
     {
         // Layer* lay = new Layer;
@@ -69,6 +74,7 @@ RouteMgr::readCircuit(const string& fileName)
         ifs >> buffer; // layerName
         ifs >> buffer; // Idx
         ifs >> buffer; // RoutingDirection
+        _layDir[i] = (buffer == "H");
         ifs >> supply; // defaultSupplyOfOneGGrid
         _laySupply[i] = supply;
     }
@@ -88,7 +94,6 @@ RouteMgr::readCircuit(const string& fileName)
             ifs >> tmpCnt1; // rowIdx
             ifs >> tmpCnt2; // colIdx
             ifs >> tmpCnt3; // LayIdx
-            MCTri dent(tmpCnt1, tmpCnt2, tmpCnt3);
             int supply;
             ifs >> buffer; // incrOrDecrValue
             if (buffer[0] == '+') {
@@ -97,32 +102,34 @@ RouteMgr::readCircuit(const string& fileName)
                 tempQ = false;
             }
             if (myStr2Int(buffer.substr(1), supply)) {
-                if (tempQ == true) {
-                    pair<MCTri, unsigned> sGd(dent, supply);
-                    this->_nonDefaultSupply.insert(sGd);
-                } else {
-                    pair<MCTri, unsigned> sGd(dent, -supply);
-                    this->_nonDefaultSupply.insert(sGd);
-                }
+                MCTri dent(tmpCnt1, tmpCnt2, tmpCnt3);
+                _nonDefaultSupply.push_back(pair<MCTri,int>(dent, tempQ ? supply : -supply));
             }
         }
+        // The first entry of a gGrid layer wins, for the 2D and 3D supply alike
+        auto triLess = [](const pair<MCTri,int>& a, const pair<MCTri,int>& b) {
+            return tie(a.first.idx1, a.first.idx2, a.first.layNum) < tie(b.first.idx1, b.first.idx2, b.first.layNum);
+        };
+        stable_sort(_nonDefaultSupply.begin(), _nonDefaultSupply.end(), triLess);
+        _nonDefaultSupply.erase(unique(_nonDefaultSupply.begin(), _nonDefaultSupply.end(),
+            [](const pair<MCTri,int>& a, const pair<MCTri,int>& b) { return a.first == b.first; }),
+            _nonDefaultSupply.end());
         ifs >> buffer; // NumMasterCell
     }
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
     cout << "genGridList\n";
     #endif
+    routeProf.stop(PROF_READ_LAYERS);
+    routeProf.start(PROF_READ_SUPPLY);
     genGridList();
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
-    cout << "Init 2D supply\n";
-    #endif
-    init2DSupply();
-    #ifdef DEBUG
-    myUsage.report(true, true);cout << "\n";
-    cout << "Init 3D supply\n";
+    cout << "Init 2D/3D supply\n";
     #endif
-    init3DSupply();
+    initSupply();
+    routeProf.stop(PROF_READ_SUPPLY);
+    routeProf.start(PROF_READ_CELLS);
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
     cout << "Reading masterCell and demand\n";
@@ -264,12 +271,16 @@ RouteMgr::readCircuit(const string& fileName)
 
     cout << "Reading init route\n";
     #endif
-    // Initial routing data
+    // Initial routing data, streamed into the nets with their 2D/3D demand.
+    // A net adds 3D demand once per layer of a gGrid: layStamp keeps the last
+    // net counted on each layer, which is exact while the segments of every
+    // net are contiguous. Otherwise the 3D demand is recounted net by net.
     ifs >> buffer; // NumRoutes
     ifs >> _initTotalSegNum; // routeSegmentCount
-    //_initRouteSegs.resize(_initTotalSegNum);
-    _bestRouteSegs.resize(_initTotalSegNum);
-
+    vector<unsigned> layStamp(_layerPool.size(), 0); // layer idx -> last net id
+    vector<bool> netSeen(_netList.size(), false);
+    unsigned lastNet = 0;
+    bool interleaved = false;
     for(unsigned i=0; i<_initTotalSegNum; ++i)
     {
         Segment* damn = new Segment();
@@ -277,13 +288,24 @@ RouteMgr::readCircuit(const string& fileName)
             ifs >> damn->startPos[j];
         for(unsigned j=0; j<3; ++j)
             ifs >> damn->endPos[j];
-        ifs >> buffer; // netName
-        int netIdx = stoi(buffer.substr(1));
-        _netList[netIdx-1]->addSeg(damn);
-
-        OutputSeg seg(*damn, (unsigned)netIdx);
-        //_initRouteSegs[i] = seg;
-        _bestRouteSegs[i] = seg;
+        unsigned netIdx = 0;
+        ifs >> ws;
+        ifs.get(); // 'N' of netName
+        ifs >> netIdx;
+        if(!ifs || netIdx < 1 || netIdx > _netList.size()){
+            cerr << "Error: illegal route segment #" << i+1 << " in \"" << fileName << "\"!!" << endl;
+            delete damn;
+            return false;
+        }
+        Net* net = _netList[netIdx-1];
+        net->addSeg(damn);
+        if(netIdx != lastNet){
+            if(netSeen[netIdx-1]) interleaved = true;
+            netSeen[netIdx-1] = true;
+            lastNet = netIdx;
+        }
+        add2DDemand(net, damn);
+        if(!interleaved) add3DDemand(net, damn, layStamp);
     }
     #ifdef DEBUG
     myUsage.report(true, true); cout << "\n";
@@ -291,6 +313,7 @@ RouteMgr::readCircuit(const string& fileName)
     cout << "initialize cell instance list of gGrids\n";
     #endif
     initCellInstList();
+    routeProf.stop(PROF_READ_CELLS);
     /*for(unsigned i=Ggrid::rBeg-1;i<Ggrid::rEnd;++i){
         for(unsigned j=Ggrid::cBeg-1;j<Ggrid::cEnd;++j){
             cout << "gGid(" << i+1 << "," << j+1 << ") has cellInst";
@@ -304,20 +327,24 @@ RouteMgr::readCircuit(const string& fileName)
     myUsage.report(true, true);cout << "\n";
     cout << "adding 2D demand\n";
     #endif
-    for(auto& m : _netList){
-        add2DDemand(m);
-    }
+    routeProf.start(PROF_READ_ROUTE_DEMAND);
     #ifdef DEBUG
-    myUsage.report(true, true);cout << "\n";
-    cout << "adding 3D demand\n";
+    cout << "adding 3D demand" << (interleaved ? " of interleaved nets\n" : " of unrouted nets\n");
     #endif
+    if(interleaved){
+        for(auto& lay : _layerPool)
+            lay.setDemand(0);
+    }
     for(auto& m : _netList){
-        add3DDemand(m);
+        if(interleaved || m->_netSegs.empty())
+            add3DDemand(m);
     }
+    routeProf.stop(PROF_READ_ROUTE_DEMAND);
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
     cout << "adding 2D Blkg demand\n";
     #endif
+    routeProf.start(PROF_READ_BLKG_DEMAND);
     for(auto& m : _instList){
         add2DBlkDemand(m);
     }
@@ -328,11 +355,14 @@ RouteMgr::readCircuit(const string& fileName)
     for(auto& m : _instList){
         add3DBlkDemand(m);
     }
+    routeProf.stop(PROF_READ_BLKG_DEMAND);
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
     cout << "adding sameGGrid/adjHGrid demand\n";
     #endif
+    routeProf.start(PROF_READ_NEIGHBOR_DEMAND);
     initNeighborDemand();
+    routeProf.stop(PROF_READ_NEIGHBOR_DEMAND);
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
     cout << "initialize associated cell instances of nets\n";
@@ -365,8 +395,10 @@ RouteMgr::readCircuit(const string& fileName)
     myUsage.report(true, true);cout << "\n";
     cout << "initialize net rank\n";
     #endif
+    routeProf.start(PROF_READ_NET_RANK);
     _netRank = new NetRank;
     _netRank->init();
+    routeProf.stop(PROF_READ_NET_RANK);
     #ifdef DEBUG
     myUsage.report(true, true);cout << "\n";
     cout << "evaluate wire length\n";
@@ -375,27 +407,92 @@ RouteMgr::readCircuit(const string& fileName)
     _initTotalWL = evaluateWireLen();
     myUsage.report(true, true);cout << "\n";
     _bestTotalWL = _initTotalWL;
+    _bestIsInit = true;
+    serializeBest();
     return true;
 }
 
 void
 RouteMgr::writeCircuit(ostream& outfile) const
 {
-    outfile << "NumMovedCellInst " << _bestMovedCells.size() << "\n";
-    for(auto m : _bestMovedCells)
-    {
-        outfile << "CellInst C" << get<0>(m) << " " << get<1>(m) << " " << get<2>(m) << "\n";
+    const string& out = _bestOutput[_bestOutputIdx.load(memory_order_acquire)];
+    outfile.write(out.data(), out.size());
+}
+
+// Only write(2) and ftruncate(2) are used, so it can be called from a
+// signal handler while storeBestResult() is filling the other buffer. While
+// a portfolio runs, a better result published by a worker is taken instead.
+bool
+RouteMgr::dumpBest(int fd) const
+{
+    if (_pfSlots && dumpWorkerBest(fd)) return true;
+    const string& out = _bestOutput[_bestOutputIdx.load(memory_order_acquire)];
+    if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0) return false;
+    const char* buf = out.data();
+    size_t left = out.size();
+    while (left > 0) {
+        ssize_t n = write(fd, buf, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n; left -= n;
+    }
+    return true;
+}
+
+static inline void
+appendUint(string& str, unsigned v)
+{
+    char buf[16];
+    char* p = buf + sizeof(buf);
+    do { *--p = '0' + v % 10; v /= 10; } while (v);
+    str.append(p, buf + sizeof(buf) - p);
+}
+
+// Format the best result into the inactive buffer, then publish it. While
+// _bestIsInit the nets themselves are the best, which only holds until the
+// first cell move or reroute; storeBestResult() clears it before that.
+void
+RouteMgr::serializeBest()
+{
+    if (_bestIsInit) {
+        size_t segNum = 0;
+        for (auto net : _netList) segNum += net->_netSegs.size();
+        assert(getCurMoveCnt() == 0 && segNum == _initTotalSegNum);
+        // Keep the published copy rather than write routes under a wrong count
+        if (getCurMoveCnt() != 0 || segNum != _initTotalSegNum) return;
+    }
+    unsigned idx = _bestOutputIdx.load(memory_order_relaxed) ^ 1;
+    string& out = _bestOutput[idx];
+    out.clear();
+    out += "NumMovedCellInst "; appendUint(out, _bestMovedCells.size()); out += '\n';
+    for (auto& m : _bestMovedCells) {
+        out += "CellInst C"; appendUint(out, get<0>(m));
+        out += ' '; appendUint(out, get<1>(m));
+        out += ' '; appendUint(out, get<2>(m)); out += '\n';
     }
-    // TODO: output routes
-    outfile << "NumRoutes " << _bestRouteSegs.size() << "\n";
-    for (unsigned i=0; i<_bestRouteSegs.size()-1; ++i) {
-        outfile << _bestRouteSegs[i].first.startPos[0] << " " << _bestRouteSegs[i].first.startPos[1] << " " << _bestRouteSegs[i].first.startPos[2] << " "
-                << _bestRouteSegs[i].first.endPos[0]   << " " << _bestRouteSegs[i].first.endPos[1]   << " " << _bestRouteSegs[i].first.endPos[2]   << " N"
-                << _bestRouteSegs[i].second << "\n";
+    if (_bestIsInit) {
+        out += "NumRoutes "; appendUint(out, _initTotalSegNum);
+        for (auto net : _netList) {
+            for (auto seg : net->_netSegs) {
+                out += '\n';
+                for (unsigned j=0; j<3; ++j) { appendUint(out, seg->startPos[j]); out += ' '; }
+                for (unsigned j=0; j<3; ++j) { appendUint(out, seg->endPos[j]); out += ' '; }
+                out += 'N'; appendUint(out, net->_netId);
+            }
+        }
+    }
+    else {
+        out += "NumRoutes "; appendUint(out, _bestRouteSegs.size());
+        for (auto& s : _bestRouteSegs) {
+            out += '\n';
+            for (unsigned j=0; j<3; ++j) { appendUint(out, s.first.startPos[j]); out += ' '; }
+            for (unsigned j=0; j<3; ++j) { appendUint(out, s.first.endPos[j]); out += ' '; }
+            out += 'N'; appendUint(out, s.second);
+        }
     }
-    outfile << _bestRouteSegs[_bestRouteSegs.size()-1].first.startPos[0] << " " << _bestRouteSegs[_bestRouteSegs.size()-1].first.startPos[1] << " " << _bestRouteSegs[_bestRouteSegs.size()-1].first.startPos[2] << " "
-            << _bestRouteSegs[_bestRouteSegs.size()-1].first.endPos[0]   << " " << _bestRouteSegs[_bestRouteSegs.size()-1].first.endPos[1]   << " " << _bestRouteSegs[_bestRouteSegs.size()-1].first.endPos[2]   << " N"
-            << _bestRouteSegs[_bestRouteSegs.size()-1].second;
+    _bestOutputIdx.store(idx, memory_order_release);
 }
 
 void    
@@ -414,6 +511,7 @@ RouteMgr::writeDemand(ostream& outfile) const{
 
 void
 RouteMgr::storeBestResult(){
+    PROF_SCOPE(PROF_STORE_BEST);
     _bestMovedCells.resize(0);
     std::set<CellInst*>::iterator ite = _curMovedSet.begin();
     for(unsigned i=0;i<_curMovedSet.size();++i){
@@ -422,6 +520,7 @@ RouteMgr::storeBestResult(){
         ++ite;
     }
 
+    _bestIsInit = false;
     _bestRouteSegs.resize(0);
     for(unsigned i=0;i<_netList.size();++i){
         for(unsigned j=0;j<_netList[i]->_netSegs.size();++j){
@@ -429,16 +528,22 @@ RouteMgr::storeBestResult(){
             _bestRouteSegs.push_back(seg);
         }
     }
+    serializeBest();
 }
 
 void
 RouteMgr::genGridList()
 {
+    unsigned layCnt = _laySupply.size();
+    _layerPool.resize(Ggrid::rEnd * Ggrid::cEnd * layCnt);
+    Ggrid::plane2D.init(Ggrid::rEnd, Ggrid::cEnd, layCnt);
+    Layer::overflowSet.init(_layerPool.data(), _layerPool.size(), layCnt);
     _gridList.resize(Ggrid::rEnd, vector<Ggrid*>(Ggrid::cEnd));
     for (unsigned i=1; i<=Ggrid::rEnd; ++i) {
         //vector<Ggrid*> bar;
         for (unsigned j=1; j<=Ggrid::cEnd; ++j) {
-            Ggrid* g = new Ggrid(Pos(i, j), _laySupply.size());
+            Layer* layers = &_layerPool[((i-1)*Ggrid::cEnd + (j-1)) * layCnt];
+            Ggrid* g = new Ggrid(Pos(i, j), layers, layCnt);
             _gridList[i-1][j-1] = g;
             //bar.push_back(g);
         }
@@ -453,58 +558,31 @@ RouteMgr::getGrid(Pos pos)
 }
 
 void
-RouteMgr::init2DSupply()
+RouteMgr::initSupply()
 {
+    // One pass over the layer pool with the default supply of each layer,
+    // then only the sparse non-default gGrids are touched
+    unsigned layCnt = _laySupply.size();
     int total_default_supply = 0;
-    for (auto const m : _laySupply) {
-        total_default_supply += m;
+    for (unsigned k=0; k<layCnt; ++k) {
+        total_default_supply += _laySupply[k];
+        _layerPool[k].setSupply(_laySupply[k]);
     }
-    int total_supply;
-
-    for (unsigned i=1; i<=Ggrid::rEnd; ++i) {
-        for (unsigned j=1; j<=Ggrid::cEnd; ++j) {
-            total_supply = total_default_supply;
-            for (unsigned k=1; k<=_laySupply.size(); ++k)
-            {
-                MCTri good = MCTri(i, j, k);
-                auto yeah = _nonDefaultSupply.find(good);
-                if (yeah != _nonDefaultSupply.cend())
-                {
-                    total_supply += yeah->second;
-                }
-            }
-            _gridList[i-1][j-1]->set2dSupply(total_supply);
+    for (size_t idx=layCnt; idx<_layerPool.size(); idx+=layCnt) {
+        copy(_layerPool.begin(), _layerPool.begin()+layCnt, _layerPool.begin()+idx);
+    }
+    for (auto& rows : _gridList) {
+        for (auto g : rows) {
+            g->set2dSupply(total_default_supply);
         }
     }
-    /*
-    Pseudo code
-    for i=1 to gridList.length
-        gridList[i]._2dSupply = total_default_supply;
-        for i=1 to _layerSupply.length
-            use unorder_map to add/sub nondefault supply
-    */
-}
 
-void
-RouteMgr::init3DSupply()
-{
-    for (unsigned i=1; i<=Ggrid::rEnd; ++i) {
-        for (unsigned j=1; j<=Ggrid::cEnd; ++j) {
-            for (unsigned k=1; k<=_laySupply.size(); ++k) {
-                Layer* grid = _gridList[i-1][j-1]->operator[](k);
-                // Find grid supply
-                unsigned total_supply = _laySupply[k-1];
-                MCTri good = MCTri(i, j, k);
-                auto yeah = _nonDefaultSupply.find(good);
-                if (yeah != _nonDefaultSupply.cend())
-                {
-                    total_supply += yeah->second;
-                }
-                grid->setSupply(total_supply);
-            }
-        }
+    for (auto& offset : _nonDefaultSupply) {
+        const MCTri& pos = offset.first;
+        Ggrid* g = _gridList[pos.idx1-1][pos.idx2-1];
+        (*g)[pos.layNum]->setSupply(_laySupply[pos.layNum-1] + offset.second);
+        g->set2dSupply(g->get2dSupply() + offset.second);
     }
-    
 }
 
 void
@@ -673,103 +751,94 @@ RouteMgr::remove3DDemand(Net* net)
 void
 RouteMgr::add2DDemand(Net* net) //Initialize after each route
 {
-    unsigned availale_layer = _laySupply.size() - net->getMinLayCons() + 1;
-    double constraint = ((double)_laySupply.size() / (double)availale_layer);
-    //cout << "Net " << net->_netId << "\n";
-    //cout << "rEnd: " << Ggrid::rEnd << " cEnd: " << Ggrid::cEnd << "\n";
-    //cout << "NetSeg.size()" << net->_netSegs.size() << endl;
-    if(net->_netSegs.size() == 0) {
-        //cout << "Net" << net->_netId << " is empty!\n";
+    int64_t demand = net2DDemand(net);
+    for(auto& s : net->_netSegs) {
+        update2DDemand(s, demand);
     }
+}
+
+void
+RouteMgr::add2DDemand(Net* net, const Segment* s)
+{
+    update2DDemand(s, net2DDemand(net));
+}
+
+// 2D demand a net puts on each gGrid it passes, in 1/unit of a track: the
+// layer count over the layers the net may use
+int64_t
+RouteMgr::net2DDemand(const Net* net) const
+{
+    int64_t layCnt = _laySupply.size();
+    int64_t availale_layer = layCnt - net->getMinLayCons() + 1;
+    int64_t unit = Ggrid::plane2D.unit();
     #ifdef DEBUG
-    cout << "Net " << net->_netId << " " << _laySupply.size() << " " << net->getMinLayCons() << " constraint " << constraint << "\n";
+    cout << "Net " << net->_netId << " " << layCnt << " " << net->getMinLayCons() << " constraint " << (double)layCnt / availale_layer << "\n";
     #endif
-    for(auto& s : net->_netSegs) {
-        if(s->startPos[2] == s->endPos[2]){
-            if(s->startPos[0] != s->endPos[0]){
-                int max = s->endPos[0];
-                int min = s->startPos[0];
-                if(s->startPos[0] > s->endPos[0]){
-                    max = s->startPos[0];
-                    min = s->endPos[0];
-                }
-                for(int j=min;j<=max;++j){
-                    _gridList[j-1][(s->startPos[1])-1]->update2dDemand(constraint);
-                }
-            }
-            else if(s->startPos[1] != s->endPos[1]){
-                int max = s->endPos[1];
-                int min = s->startPos[1];
-                if(s->startPos[1] > s->endPos[1]){
-                    max = s->startPos[1];
-                    min = s->endPos[1];
-                }
-                for(int j=min; j<=max; ++j){
-                    //cout << "Net " << net->_netId << " " << s->startPos[0]-1 << " " << j-1 << "\n";
-                    _gridList[(s->startPos[0])-1][j-1]->update2dDemand(constraint);
-                }
-            }
+    return (unit * layCnt + availale_layer / 2) / availale_layer;
+}
+
+// Add demand (negative to remove) to every gGrid a segment passes, a via
+// counting once per layer it spans
+void
+RouteMgr::update2DDemand(const Segment* s, int64_t demand)
+{
+    unsigned cEnd = Ggrid::cEnd;
+    if(s->startPos[2] == s->endPos[2]){
+        if(s->startPos[0] != s->endPos[0]){
+            unsigned lo = min(s->startPos[0], s->endPos[0]), hi = max(s->startPos[0], s->endPos[0]);
+            Ggrid::plane2D.addRun((lo-1) * cEnd + (s->startPos[1]-1), hi-lo+1, cEnd, demand);
         }
-        else{
-            int num_of_layer = abs((int)(s->startPos[2]) - (int)(s->endPos[2])) + 1;
-            #ifdef DEBUG
-            cout << "num_of_layer " << num_of_layer << "\n";
-            #endif
-            _gridList[(s->startPos[0])-1][(s->startPos[1])-1]->update2dDemand(num_of_layer*constraint);
+        else if(s->startPos[1] != s->endPos[1]){
+            unsigned lo = min(s->startPos[1], s->endPos[1]), hi = max(s->startPos[1], s->endPos[1]);
+            Ggrid::plane2D.addRun((s->startPos[0]-1) * cEnd + (lo-1), hi-lo+1, 1, demand);
         }
     }
-    /*Psuedo Code
-    unsigned available_layer = _layerSupply.length - net->_minLayCons;
-    double constraint = _layerSupply.length/available_layer;
+    else{
+        int num_of_layer = abs((int)(s->startPos[2]) - (int)(s->endPos[2])) + 1;
+        #ifdef DEBUG
+        cout << "num_of_layer " << num_of_layer << "\n";
+        #endif
+        Ggrid::plane2D.addDemand((s->startPos[0]-1) * cEnd + (s->startPos[1]-1), num_of_layer * demand);
+    }
+}
 
-    go through net, for every passing grid g, call g.updateDemand(constraint)
-    */
+// 3D demand of one segment while streaming the initial routes; a layer
+// already stamped with this net is not counted again
+void
+RouteMgr::add3DDemand(Net* net, const Segment* s, vector<unsigned>& layStamp)
+{
+    if (!s->isValid()) return;
+    unsigned layCnt = _laySupply.size();
+    unsigned lo[3], hi[3];
+    for (unsigned d=0; d<3; ++d) {
+        lo[d] = min(s->startPos[d], s->endPos[d]);
+        hi[d] = max(s->startPos[d], s->endPos[d]);
+    }
+    // Same walk as Segment::passGrid()
+    SegDirection dir = s->checkDir();
+    if (dir == DIR_H) { lo[0] = hi[0] = s->startPos[0]; lo[2] = hi[2] = s->startPos[2]; }
+    else if (dir == DIR_V) { lo[1] = hi[1] = s->startPos[1]; lo[2] = hi[2] = s->startPos[2]; }
+    else { lo[0] = hi[0] = s->startPos[0]; lo[1] = hi[1] = s->startPos[1]; }
+    for (unsigned r=lo[0]; r<=hi[0]; ++r)
+        for (unsigned c=lo[1]; c<=hi[1]; ++c)
+            for (unsigned l=lo[2]; l<=hi[2]; ++l) {
+                size_t idx = ((size_t)(r-1) * Ggrid::cEnd + (c-1)) * layCnt + (l-1);
+                if (layStamp[idx] == net->_netId) continue;
+                layStamp[idx] = net->_netId;
+                _layerPool[idx].addDemand(1);
+            }
 }
 
 void 
 RouteMgr::remove2DDemand(Net* net) //before each route
 {
-    unsigned availale_layer = _laySupply.size() - net->getMinLayCons() + 1;
-    double constraint = (double) (_laySupply.size() / availale_layer);
     #ifdef DEBUG
     cout << "Net " << net->_netId << "\n";
     #endif
+    int64_t demand = net2DDemand(net);
     for(auto& s : net->_netSegs) {
-        if(s->startPos[2] == s->endPos[2]){
-            if(s->startPos[0] != s->endPos[0]){
-                int max = s->endPos[0];
-                int min = s->startPos[0];
-                if(s->startPos[0] > s->endPos[0]){
-                    max = s->startPos[0];
-                    min = s->endPos[0];
-                }
-                for(int j=min;j<=max;++j){
-                    _gridList[j-1][(s->startPos[1])-1]->update2dDemand(-constraint);
-                }
-            }
-            else if(s->startPos[1] != s->endPos[1]){
-                int max = s->endPos[1];
-                int min = s->startPos[1];
-                if(s->startPos[1] > s->endPos[1]){
-                    max = s->startPos[1];
-                    min = s->endPos[1];
-                }
-                for(int j=min;j<=max;++j){
-                    _gridList[(s->startPos[0])-1][j-1]->update2dDemand(-constraint);
-                }
-            }
-        }
-        else{
-            int num_of_layer = abs((int)(s->startPos[2]) - (int)(s->endPos[2])) + 1;
-            _gridList[(s->startPos[0])-1][(s->startPos[1])-1]->update2dDemand(-num_of_layer*constraint);
-        }
+        update2DDemand(s, -demand);
     }
-    /*Psuedo Code
-    unsigned available_layer = _layerSupply.length - net->_minLayCons;
-    double constraint = _layerSupply.length/available_layer;
-
-    go through net, for every passing grid g, call g.updateDemand(-constraint)
-    */
 }
 
 void
@@ -819,7 +888,7 @@ RouteMgr::addNeighborDemand(MC* mc_a, MC* mc_b, Ggrid* grid, bool type){
     if(type == 0){
         for(unsigned i=0;i<_laySupply.size();++i){
             MCTri t(mc_a->_mcId, mc_b->_mcId, i+1);
-            std::unordered_map<MCTri, unsigned, TriHash>::iterator it = _sameGridDemand.find(t);
+            MCTriMap::iterator it = _sameGridDemand.find(t);
             if(it!=_sameGridDemand.end()){
                 (*grid)[it->first.layNum]->addDemand(it->second);
                 grid->update2dDemand(it->second);
@@ -834,7 +903,7 @@ RouteMgr::addNeighborDemand(MC* mc_a, MC* mc_b, Ggrid* grid, bool type){
     else{
         for(unsigned i=0;i<_laySupply.size();++i){
             MCTri t(mc_a->_mcId, mc_b->_mcId, i+1);
-            std::unordered_map<MCTri, unsigned, TriHash>::iterator it = _adjHGridDemand.find(t);
+            MCTriMap::iterator it = _adjHGridDemand.find(t);
             if(it!=_adjHGridDemand.end()){
                 (*grid)[it->first.layNum]->addDemand(it->second);
                 grid->update2dDemand(it->second);
@@ -853,7 +922,7 @@ RouteMgr::removeNeighborDemand(MC* mc_a, MC* mc_b, Ggrid* grid, bool type){
     if(type == 0){
         for(unsigned i=0;i<_laySupply.size();++i){
             MCTri t(mc_a->_mcId, mc_b->_mcId, i+1);
-            std::unordered_map<MCTri, unsigned, TriHash>::iterator it = _sameGridDemand.find(t);
+            MCTriMap::iterator it = _sameGridDemand.find(t);
             if(it!=_sameGridDemand.end()){
                 (*grid)[it->first.layNum]->removeDemand(it->second);
                 grid->update2dDemand(-(int)(it->second));
@@ -868,7 +937,7 @@ RouteMgr::removeNeighborDemand(MC* mc_a, MC* mc_b, Ggrid* grid, bool type){
     else{
         for(unsigned i=0;i<_laySupply.size();++i){
             MCTri t(mc_a->_mcId, mc_b->_mcId, i+1);
-            std::unordered_map<MCTri, unsigned, TriHash>::iterator it = _adjHGridDemand.find(t);
+            MCTriMap::iterator it = _adjHGridDemand.find(t);
             if(it!=_adjHGridDemand.end()){
                 (*grid)[it->first.layNum]->removeDemand(it->second);
                 grid->update2dDemand(-(int)(it->second));
@@ -907,73 +976,60 @@ RouteMgr::check3dOverflow(unsigned i, unsigned j, unsigned k) {
     return myStatus;
 }
 
+// One pass over the layer pool, counting the status of each layer
 void RouteMgr::checkAllGrids()
 {
-    /*
-    int healthyCnt = 0;
-    int riskyCnt = 0;
-    int fullCnt = 0;
-    int OVCNT = 0;
-    */
-    for (unsigned k=1; k<=routeMgr->getLayerCnt(); ++k) {
-        int healthyCnt = 0;
-        int riskyCnt = 0;
-        int fullCnt = 0;
-        int OVCNT = 0;
-        for (unsigned i=1; i<=Ggrid::rEnd; ++i) {
-            for (unsigned j=1; j<=Ggrid::cEnd; ++j) {
-                auto myStatus = this->check3dOverflow(i, j, k);
-                switch (myStatus)
-                {
-                case GRID_HEALTHY:
-                    ++healthyCnt;
-                    break;
-                case GRID_RISKY:
-                    ++riskyCnt;
-                    break;
-                case GRID_FULL_CAP:
-                    ++fullCnt;
-                    break;
-                case GRID_OVERFLOW:
-                    ++OVCNT;
-                    break;
-                default:
-                    break;
-                }
-            }
+    unsigned layCnt = getLayerCnt();
+    vector<int> healthyCnt(layCnt, 0), riskyCnt(layCnt, 0), fullCnt(layCnt, 0), OVCNT(layCnt, 0);
+    for (size_t idx=0; idx<_layerPool.size(); ++idx) {
+        unsigned k = idx % layCnt;
+        switch (_layerPool[idx].checkOverflow())
+        {
+        case GRID_HEALTHY:
+            ++healthyCnt[k];
+            break;
+        case GRID_RISKY:
+            ++riskyCnt[k];
+            break;
+        case GRID_FULL_CAP:
+            ++fullCnt[k];
+            break;
+        case GRID_OVERFLOW:
+            ++OVCNT[k];
+            break;
+        default:
+            break;
         }
-        cout << "\nLayer " << k << "\n";
-        cout << healthyCnt << " grids are healthy\n";
-        cout << riskyCnt << " grids are risky\n";
-        cout << fullCnt << " grids are full!\n";
-        cout << OVCNT << " grids overflow!\n";
     }
-    
+    for (unsigned k=0; k<layCnt; ++k) {
+        cout << "\nLayer " << k+1 << "\n";
+        cout << healthyCnt[k] << " grids are healthy\n";
+        cout << riskyCnt[k] << " grids are risky\n";
+        cout << fullCnt[k] << " grids are full!\n";
+        cout << OVCNT[k] << " grids overflow!\n";
+    }
 }
 
+// List the overflowed layers from Layer::overflowSet, in O(#overflows)
 bool
 RouteMgr::checkOverflow()
 {
-    int OVCNT = 0;	
+    unsigned layCnt = getLayerCnt();
+    vector<unsigned> over = Layer::overflowSet.members();
+    sort(over.begin(), over.end());
     _overflowGgrids.clear();
     _overflowLayers.clear();
-    for (unsigned k=1; k<=routeMgr->getLayerCnt(); ++k) {
-        for (unsigned i=1; i<=Ggrid::rEnd; ++i) {
-            for (unsigned j=1; j<=Ggrid::cEnd; ++j) {
-                if (this->check3dOverflow(i, j, k) == GRID_OVERFLOW) {
-                    #ifdef DEBUG
-                    cerr << "(" << i << ", " << j << ", "
-                        << k << ") ";
-                    #endif
-                    _overflowGgrids.push_back(this->_gridList[i-1][j-1]);
-                    _overflowLayers.push_back((*(this->_gridList[i-1][j-1]))[k]);
-                    ++OVCNT;
-                }
-            }
-        }
+    for (auto idx : over) {
+        unsigned gridIdx = idx / layCnt;
+        #ifdef DEBUG
+        cerr << "(" << gridIdx / Ggrid::cEnd + 1 << ", " << gridIdx % Ggrid::cEnd + 1 << ", "
+            << idx % layCnt + 1 << ") ";
+        #endif
+        _overflowGgrids.push_back(_gridList[gridIdx / Ggrid::cEnd][gridIdx % Ggrid::cEnd]);
+        _overflowLayers.push_back(&_layerPool[idx]);
     }
-    cout << OVCNT << " grids overflow!\n";
-    return OVCNT;
+    cout << over.size() << " grids overflow!\n";
+    return !over.empty();
 }
 
 bool
@@ -991,7 +1047,7 @@ RouteMgr::reduceOverflow()
                 if (!net->checkOverflow()) {
                     cout << "Net " << net->_netId << " no Overflow!\n";
                 }
-                if (!checkOverflow()) { return true; }
+                if (!getOverflowCnt()) { return true; }
             }
         }
     }
@@ -1000,6 +1056,7 @@ RouteMgr::reduceOverflow()
 
 unsigned 
 RouteMgr::evaluateWireLen() const{
+    PROF_SCOPE(PROF_EVAL_WL);
     unsigned newWL = 0;
     // cout << "evalueateWireLen" << endl;
     for (auto n : _netList){
@@ -1014,6 +1071,13 @@ RouteMgr::evaluateWireLen() const{
     return newWL;
 }
 
+// Number of overflowed layers over all gGrids
+unsigned
+RouteMgr::getOverflowCnt() const
+{
+    return Layer::overflowSet.size();
+}
+
 unsigned 
 RouteMgr::evaluateWireLen(Net* n) const{
     set<Layer*> alpha;
@@ -1026,9 +1090,16 @@ RouteMgr::replaceBest(){
     //cout << "Evaluating WL ..." << endl;
     unsigned newWL = evaluateWireLen();
     if(newWL < _bestTotalWL){
+        #ifdef DEBUG
+        unsigned verifyWL = 0;
+        if (!verify(&verifyWL) || verifyWL != newWL)
+            cout << "[Error!] Best solution fails verification, WL " << verifyWL << "\n";
+        #endif
         storeBestResult();
         _bestTotalWL = newWL;
         cout << _bestTotalWL << " is a Better Solution!!\n";
+        saveCheckpoint();
+        publishBest();
     }
 }
 
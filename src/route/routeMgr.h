@@ -15,12 +15,27 @@
 #include <iostream>
 #include <tuple>
 #include <ctime>
+#include <chrono>
+#include <atomic>
+#include <cfloat>
+#include <sys/types.h>
 #include "routeNet.h"
+#include "routeHeap.h"
+#include "routeCache.h"
 
 using namespace std;
 
 extern RouteMgr *routeMgr;
 
+struct PortfolioSlot;
+
+// A rectangle of gGrids, bounds included
+struct GridRect
+{
+    unsigned rBeg, cBeg, rEnd, cEnd;
+    bool contains(unsigned r, unsigned c) const { return r >= rBeg && r <= rEnd && c >= cBeg && c <= cEnd; }
+};
+
 class RouteMgr
 {
 friend CellInst;
@@ -29,11 +44,13 @@ friend NetRank;
 friend void Segment::passGrid(Net*, set<Layer*>&) const;
 friend set<Layer*> Segment::newGrid(Net* net, set<Layer*>& alpha) const;
 public:
-    RouteMgr() : _placeStrategy(FORCE_DIRECTED) { _startTime = clock(); }
+    RouteMgr() : _placeStrategy(FORCE_DIRECTED), _timeBudget(DBL_MAX), _rerouteRate(0), _preciseRate(0),
+                 _bestOutputIdx(0), _netRank(0), _ckptPid(0), _lastCkptTime(0) { _startTime = chrono::steady_clock::now(); }
     ~RouteMgr() { // TODO: reset();
     }    
     bool    readCircuit(const string&);
     void    writeCircuit(ostream&) const;
+    bool    dumpBest(int fd) const; // async-signal-safe
     void    setRouteLog(ofstream *logFile) { _tempRoute = logFile; }
     void    genGridList();
     Ggrid*  getGrid(Pos);
@@ -83,6 +100,8 @@ public:
     unsigned getCellCnt() const {
       return _instList.size();
     }
+    unsigned getBestWL() const { return _bestTotalWL; }
+    unsigned getOverflowCnt() const;
 
     unsigned evaluateWireLen() const;
     unsigned evaluateWireLen(Net*) const;
@@ -97,15 +116,31 @@ public:
     size_t   getCurMoveCnt() const { return _curMovedSet.size(); }
     void     netbasedPlace();
     void     forcedirectedPlace ();
+    void     setPlaceBatch(unsigned n) { _placeBatch = n ? n : 1; }
     unsigned Share(Net*,Net*);
     pair<double,double> Move(Net*,Net*,double);
     void     moveOneCell(unsigned,Pos,unsigned);
+    bool     annealPlace(double seconds);
+    bool     commitPlacement(const vector<pair<CellInst*,Pos>>&);
 
     RouteExecStatus    errorOption(RouteExecError);
     RouteExecStatus    route2D(Net*);
+    RouteExecStatus    route3D(Net*);
+    void               setRoute3D(double viaCost) { _route3D = true; _viaCost = viaCost; }
+    void               setBidir(unsigned minDist) { _bidirMinDist = minDist; }
     RouteExecStatus    route();
     RouteExecStatus    reroute();
     RouteExecStatus    reroute(Net*);
+    unsigned           netLowerBound(const Net*) const;
+    bool               atLowerBound(Net*) const;
+    void               setSkipSlack(unsigned slack) { _skipSlack = slack; }
+    void               setRouteCache(unsigned entries) { _routeCache.setCapacity(entries); }
+    void               setJobs(unsigned n) { _jobs = n ? n : 1; }
+    bool               inRouteWindow(unsigned r, unsigned c) const {
+        return (!_routeWin.rEnd || _routeWin.contains(r, c)) &&
+               (!_corridorOn || _corridorMark[((r-1) / _coarseTile) * _coarseCols + (c-1) / _coarseTile] == _corridorRun);
+    }
+    void               setCoarse(unsigned tileSize) { _coarseTile = tileSize; }
     void    koova_place();
     void    change_notifier(CellInst*);
     void    koova_route();
@@ -113,13 +148,31 @@ public:
     bool    findCand(unsigned min, unsigned max, vector<int>&);
     RouteExecStatus    layerassign(Net*);
 
+    /**********************************/
+    /*          Time budget           */
+    /**********************************/
+    void     setTimeBudget(double sec) { _timeBudget = sec; }
+    double   getElapsedTime() const {
+      return chrono::duration<double>(chrono::steady_clock::now() - _startTime).count();
+    }
+    double   getRemainingTime() const { return _timeBudget - getElapsedTime(); }
+    bool     timeUp() const { return getElapsedTime() >= _timeBudget; }
+    void     schedulePnR();
+    void     schedulePortfolio(unsigned workers, const string& spoolBase);
+    void     abortPortfolio() const; // async-signal-safe
+    void     schedulePreciseRounds();
+    bool     scheduleReroute();
+    bool     schedulePrecisePnR();
+    bool     scheduleAnneal();
+    unsigned preciseWorkload() const;
+
     /**********************************/
     /*      Overflow prevention       */
     /**********************************/
-    void    init2DSupply();
-    void    init3DSupply();
+    void    initSupply();
     void    passGrid(Net*, set<Layer*>&) const;
     void    add3DDemand(Net*);
+    void    add3DDemand(Net*, const Segment*, vector<unsigned>& layStamp);
     void    remove3DDemand(Net*);
     void    add3DBlkDemand(CellInst*);
     void    remove3DBlkDemand(CellInst*);
@@ -128,7 +181,10 @@ public:
     void    addNeighborDemand(MC*, MC*, Ggrid*, bool); //type=0: same gGrid, type=1: adj gGrid
     void    removeNeighborDemand(MC*, MC*, Ggrid*, bool);
     void    add2DDemand(Net*);
+    void    add2DDemand(Net*, const Segment*);
     void    remove2DDemand(Net*);
+    int64_t net2DDemand(const Net*) const;
+    void    update2DDemand(const Segment*, int64_t demand);
     void    add2DBlkDemand(CellInst*);
     void    remove2DBlkDemand(CellInst*);
     //void    add2DNeighborDemand(CellInst*, CellInst*, bool type); 
@@ -148,6 +204,23 @@ public:
     /*            Output              */
     /**********************************/ 
     void    storeBestResult();
+    void    serializeBest();
+
+    /**********************************/
+    /*          Verification          */
+    /**********************************/
+    bool    verify(unsigned* wireLen = 0) const;
+    bool    readOutput(const string&);
+
+    /**********************************/
+    /*           Checkpoint           */
+    /**********************************/
+    void    setCheckpoint(const string& fileName) { _ckptFile = fileName; }
+    bool    writeCheckpoint(const string&) const;
+    bool    readCheckpoint(const string&);
+    void    saveCheckpoint(bool force = false);
+    void    waitCheckpoint();
+    void    removeCheckpoint();
 
 private:
     // Initial
@@ -158,16 +231,21 @@ private:
     MCList            _mcList; // id->MC*
     InstList          _instList; // 1D array
     GridList          _gridList; // 2D array
+    vector<Layer>     _layerPool; // ((row-1)*cEnd+(col-1))*layCnt+(lay-1) -> layer of gGrid
     NetList           _netList;  // Net
-    vector<bool>      _layDir; // layId -> Horizontal or Vertical
+    vector<bool>      _layDir; // layId -> Horizontal (true) or Vertical
     vector<unsigned>  _laySupply; // layId -> default supply
-    unordered_map<MCTri, unsigned, TriHash>   _sameGridDemand;
-    unordered_map<MCTri, unsigned, TriHash>   _adjHGridDemand;
-    unordered_map<MCTri, int, TriHash>        _nonDefaultSupply; // supply offset row,col,lay
+    MCTriMap          _sameGridDemand;
+    MCTriMap          _adjHGridDemand;
+    vector<pair<MCTri,int>> _nonDefaultSupply; // (row,col,lay) -> supply offset
     
     // Current
     PlaceStrategy     _placeStrategy; // 0 for force-directed, 1 for congestion-based move
-    clock_t           _startTime;
+    unsigned          _placeBatch = 1; // cells moved by forcedirectedPlace() before one route()
+    chrono::steady_clock::time_point _startTime; // monotonic wall clock
+    double            _timeBudget; // seconds from _startTime
+    double            _rerouteRate; // measured seconds per net of reroute()
+    double            _preciseRate; // measured seconds per trial cell of precisePnR()
     unsigned          _initTotalWL;
     InstSet           _curMovedSet;
     NetList           _targetNetList;
@@ -176,23 +254,83 @@ private:
     unsigned          _numOverflowNet3 = 0;
     unsigned          _numValidNet1 = 0;
     unsigned          _numValidNet2 = 0;
+    unsigned          _numRouted3D = 0;
+    unsigned          _numAtBound = 0; // nets reroute() skipped
+    unsigned          _skipSlack = 0; // reroute() skips nets at most this far above their lower bound
+    bool              _route3D = false; // reroute(Net*) falls back to route3D()
+    double            _viaCost = 0; // extra route3D() cost of a layer change
+    unsigned          _jobs = 1; // worker processes of reroute()
+    GridRect          _routeWin = { 0, 0, 0, 0 }; // gGrids the routers may use, whole grid if rEnd is 0
 
     // Results
     vector<OutputCell>_bestMovedCells;
-    vector<OutputSeg> _bestRouteSegs; // TODO: check redundancy
+    vector<OutputSeg> _bestRouteSegs; // empty while _bestIsInit
+    bool              _bestIsInit = false; // best is the input solution, held by the nets
     unsigned          _bestTotalWL;
+    string            _bestOutput[2]; // serialized best result, double-buffered
+    atomic<unsigned>  _bestOutputIdx; // buffer dumpBest() writes
     ofstream*         _tempRoute;
     NetRank*          _netRank;
     vector<Ggrid*>    _overflowGgrids;
     LayerList         _overflowLayers;
+    IndexedHeap       _fdHeap; // cell idx -> 2D congestion, candidates of forcedirectedPlace()
+    bool              _fdHeapBuilt = false;
+    vector<double>    _mazeDist; // gGrid idx -> route3D() path cost, valid if _mazeSeen is _mazeRun
+    vector<unsigned>  _mazePrev;
+    vector<unsigned>  _mazeSeen;
+    vector<bool>      _mazeTree; // gGrid idx -> on the net being routed by route3D()
+    unsigned          _mazeRun = 0;
+    unsigned          _bidirMinDist = 0; // route2Pin() searches from both ends this far or farther, 0: never
+    vector<double>    _bidirG[2]; // gGrid idx -> route2PinBidir() cost from the tree (0) or from the pin (1)
+    vector<unsigned>  _bidirPrev[2]; // valid if _bidirSeen is _bidirRun
+    vector<unsigned>  _bidirSeen[2];
+    vector<unsigned>  _bidirDone[2]; // expanded if _bidirRun
+    unsigned          _bidirRun = 0;
+    unsigned          _coarseTile = 0; // gGrids per side of a coarse tile, 0: no coarse routing
+    unsigned          _coarseRows = 0;
+    unsigned          _coarseCols = 0;
+    vector<double>    _coarseCost; // tile idx -> cost of crossing the tile, from the 3D demand
+    vector<unsigned>  _corridorMark; // tile idx -> in the corridor if _corridorRun
+    unsigned          _corridorRun = 0;
+    bool              _corridorOn = false; // inRouteWindow() also requires the corridor
+    RouteCache        _routeCache; // routes of route(), by net and pin geometry
+
+    // Checkpoint
+    string            _ckptFile; // empty: checkpoint disabled
+    pid_t             _ckptPid; // writer process of the last snapshot
+    time_t            _lastCkptTime;
+
+    // Portfolio
+    PortfolioSlot*    _pfSlots = 0; // worker idx -> published best WL, 0: no portfolio running
+    unsigned          _pfWorkers = 0;
+    unsigned          _pfSelf = 0; // worker idx of this process, 0: the parent
+    vector<pid_t>     _pfPids; // worker idx -> pid, 0 once reaped
+    vector<string>    _pfFiles; // worker idx -> file holding its published best output
+    vector<string>    _pfTmpFiles;
+    void     publishBest();
+    bool     dumpWorkerBest(int fd) const;
 
     //Placement Helper Function
     static bool compare(pair<unsigned,double> a, pair<unsigned,double> b) { return a.second < b.second; }
     static bool compareLength(Net* a, Net* b) { return a->_reducedLength < b->_reducedLength; }
     unsigned moveCellNum();
+    void     relocateCell(CellInst*, Pos);
+    void     buildFdHeap();
+    void     flushCongDirty();
+    unsigned netHPWL(Net*, CellInst*, Pos) const;
+    void     planPreciseMoves(vector<unsigned>&, bool) const;
+    void     partitionRegions(vector<GridRect>&, vector<unsigned>&) const;
+    void     rerouteRegions(vector<bool>&);
 
     //Routing Helper function
-    bool route2Pin(Pos p1, Pos p2, Net* net, double demand, unsigned lay1, unsigned lay2);
+    bool route2Pin(vector<Pos>& tree, Pos p2, Net* net, int64_t demand, unsigned lay1, unsigned lay2);
+    bool search2Pin(const vector<Pos>& tree, const vector<Pos>& sources, Pos p2, unsigned minDist, vector<Pos>& path);
+    bool route2PinBidir(const vector<Pos>& tree, const vector<Pos>& sources, Pos p2, vector<Pos>& path);
+    void buildCoarseGrid();
+    bool setCorridor(const vector<Pos>& sources, Pos p2);
+    uint64_t netPinKey(const Net*, vector<unsigned>& pins) const;
+    bool routeFromCache(Net*, uint64_t key, const vector<unsigned>& pins);
+    void cacheRoute(Net*, uint64_t key, const vector<unsigned>& pins);
     Pos getPinPos(const PinPair) const; // 2D
     unsigned getPinLay(const PinPair) const;
 };
@@ -18,10 +18,65 @@ unsigned Ggrid::rEnd = 0;
 unsigned Ggrid::cEnd = 0;
 unsigned Ggrid::rBeg = 0;
 unsigned Ggrid::cBeg = 0;
+vector<Ggrid*> Ggrid::congDirtyList;
+Plane2D Ggrid::plane2D;
+OverflowSet Layer::overflowSet;
 
-static bool CompareWL(PinPair a, PinPair b)
+/**********************************/
+/* class Plane2D member functions */
+/**********************************/
+// unit is the lcm of 1..layCnt, so that layCnt/k tracks is exact for every
+// k; past PLANE_MAX_UNIT the remaining ratios are rounded, which keeps the
+// add/remove symmetry but not the exact value
+#define PLANE_MAX_UNIT (1LL << 40)
+
+void Plane2D::init(unsigned rows, unsigned cols, unsigned layCnt)
+{
+    _rows = rows;
+    _cols = cols;
+    _unit = 1;
+    for (int64_t k=2; k<=(int64_t)layCnt; ++k) {
+        int64_t a = _unit, b = k;
+        while (b) { int64_t t = a % b; a = b; b = t; }
+        if (_unit / a * k > PLANE_MAX_UNIT) break;
+        _unit = _unit / a * k;
+    }
+    size_t size = (size_t)rows * cols;
+    _supply.assign(size, 0);
+    _demand.assign(size, 0);
+    _congestion.assign(size, 1);
+    _congStale.assign(rows, 0);
+    _rowTouched.assign(rows, 0);
+}
+
+// A run along a row is one contiguous loop the compiler vectorizes; a run
+// along a column marks one row per gGrid
+void Plane2D::addRun(unsigned idx, unsigned cnt, unsigned stride, int64_t delta)
+{
+    if (!cnt) return;
+    int64_t* d = &_demand[idx];
+    if (stride == 1) {
+        for (unsigned i=0; i<cnt; ++i) d[i] += delta;
+        markRow(idx / _cols);
+    }
+    else {
+        for (unsigned i=0; i<cnt; ++i) {
+            d[(size_t)i * stride] += delta;
+            markRow((idx + i * stride) / _cols);
+        }
+    }
+}
+
+// Same formula as the per-gGrid update it replaces, over a whole row
+void Plane2D::updateRow(unsigned r)
 {
-    return a.second > b.second;
+    const int* s = &_supply[(size_t)r * _cols];
+    const int64_t* d = &_demand[(size_t)r * _cols];
+    double* c = &_congestion[(size_t)r * _cols];
+    const double unit = (double)_unit;
+    for (unsigned j=0; j<_cols; ++j)
+        c[j] = ((double)s[j] - ((double)d[j] / unit) * CONGESTION_PARAMETER) / (double)s[j];
+    _congStale[r] = 0;
 }
 
 /********************************/
@@ -66,25 +121,13 @@ Layer::checkOverflow() const
 /********************************/
 /* class Ggrid member functions */
 /********************************/
-unsigned
-Ggrid::getOverflowCount() const {
-    unsigned OVCNT = 0;
-    for (auto& grid : _layerList)
-    {
-        if (grid->checkOverflow() == GRID_OVERFLOW)
-        {
-            ++OVCNT;
-        }
-    }
-    return OVCNT;
-}
 
 void
 Ggrid::printSummary() const
 {
-    cout << "\n2D Supply: " << _2dSupply
-         << "\n2D Demand: " << _2dDemand
-         << "\n2D Congestion: " << _2dCongestion << "\n";
+    cout << "\n2D Supply: " << get2dSupply()
+         << "\n2D Demand: " << get2dDemand()
+         << "\n2D Congestion: " << plane2D.getCongestion(_idx) << "\n";
     cout << "CellInst on Ggrid: ";
     for (auto& m : cellInstList)
     {
@@ -193,7 +236,9 @@ void CellInst::printAssoNet() const
 
 void CellInst::move(Pos newPos)
 {
+    _grid->markCongDirty();
     _grid = routeMgr->_gridList[newPos.first - 1][newPos.second - 1];
+    _grid->markCongDirty();
 }
 
 unsigned
@@ -454,6 +499,8 @@ unsigned Net::getWirelength()
 
 void Net::reduceSeg()
 {
+    if (routeMgr->_netRank)
+        routeMgr->_netRank->markDirty(_netId);
     vector<Segment*> toDel;
     auto it = _netSegs.begin();
     while (it != _netSegs.end())
@@ -615,6 +662,8 @@ void Net::printAllSeg(ostream &outfile) const
 
 void Net::ripUp()
 {
+    if (routeMgr->_netRank)
+        routeMgr->_netRank->markDirty(_netId);
     for (auto seg : _netSegs)
     {
         delete seg;
@@ -695,22 +744,58 @@ bool Net::findHCand(vector<int> &candsH)
 /**********************************/
 void NetRank::init()
 {
+    unsigned netCnt = routeMgr->_netList.size();
+    NetWLpairs.clear();
+    _netWL.assign(netCnt, 0);
+    _dirtyNets.clear();
+    _isDirty.assign(netCnt, false);
     for (auto net : routeMgr->_netList)
     {
         set<Layer *> alpha;
         routeMgr->passGrid(net, alpha);
         unsigned WL = alpha.size();
-        PinPair newpair = PinPair(net->_netId, WL);
-        NetWLpairs.push_back(newpair);
+        _netWL[net->_netId - 1] = WL;
+        NetWLpairs.insert(PinPair(net->_netId, WL));
     }
-    ::sort(NetWLpairs.begin(), NetWLpairs.end(), CompareWL);
 }
 
 void NetRank::update()
 {
+    for (auto netId : _dirtyNets)
+    {
+        _isDirty[netId - 1] = false;
+        set<Layer *> alpha;
+        routeMgr->passGrid(routeMgr->_netList[netId - 1], alpha);
+        unsigned WL = alpha.size();
+        if (WL == _netWL[netId - 1])
+            continue;
+        NetWLpairs.erase(PinPair(netId, _netWL[netId - 1]));
+        NetWLpairs.insert(PinPair(netId, WL));
+        _netWL[netId - 1] = WL;
+    }
+    _dirtyNets.clear();
+}
+
+// Restore a rank saved by writeCheckpoint(), the nets are all clean.
+// A rank that does not cover every net once is recomputed instead.
+void NetRank::load(const vector<PinPair>& rank)
+{
+    unsigned netCnt = routeMgr->_netList.size();
     NetWLpairs.clear();
-    init();
-    // TODO: less memory cost
+    _netWL.assign(netCnt, 0);
+    _dirtyNets.clear();
+    _isDirty.assign(netCnt, false);
+    vector<bool> seen(netCnt, false);
+    for (auto &nwPair : rank)
+    {
+        if (nwPair.first < 1 || nwPair.first > netCnt || seen[nwPair.first - 1])
+            break;
+        seen[nwPair.first - 1] = true;
+        _netWL[nwPair.first - 1] = nwPair.second;
+        NetWLpairs.insert(nwPair);
+    }
+    if (NetWLpairs.size() != netCnt)
+        init();
 }
 
 vector<unsigned>
@@ -18,7 +18,12 @@
 #include <set>
 #include <map>
 #include <cassert>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <algorithm>
 #include "routeDef.h"
+#include "routeHash.h"
 
 using namespace std;
 
@@ -37,6 +42,7 @@ extern RouteMgr *routeMgr;
 //self defined struct for sameGrid & adjGrid MC pairs & nonDefault
 struct MCTri{
   unsigned idx1, idx2, layNum;
+  MCTri() : idx1(0), idx2(0), layNum(0) {}
   MCTri(const unsigned n1, const unsigned n2, const unsigned layN){
     idx1 = n1;
     idx2 = n2;
@@ -47,18 +53,13 @@ struct MCTri{
             (this->layNum == p.layNum);
   }
 };
-// hasher for triple
+// hasher for triple, packing is collision-free for ids < 2^24 and layers < 2^16
 struct TriHash{
   size_t operator()(const MCTri& p) const{
-    return ((p.idx1 << 13)+(p.idx2 << 27)+p.layNum);
-  }
-};
-// hasher for ordered pair
-struct PairHash{
-  size_t operator() (const pair<unsigned, unsigned>& p) const{
-    return ((p.first << 16)+p.second);
+    return hashMix(((uint64_t)p.idx1 << 40) ^ ((uint64_t)p.idx2 << 16) ^ p.layNum);
   }
 };
+typedef FlatHashMap<MCTri, unsigned, TriHash> MCTriMap;
 
 enum SegDirection
 {
@@ -153,6 +154,35 @@ private:
 
 
 
+// Overflowed layers of RouteMgr's layer pool, kept up to date by every
+// supply or demand change of a Layer: their count, an indexed set of
+// their pool indices and a count per gGrid. A Layer outside the pool is
+// not tracked.
+class OverflowSet
+{
+public:
+    OverflowSet() : _base(0), _layCnt(1) {}
+    void init(const Layer* base, size_t poolSize, unsigned layCnt) {
+        _base = base;
+        _layCnt = layCnt;
+        _members.clear();
+        _slot.assign(poolSize, UINT_MAX);
+        _gridCnt.assign(poolSize / layCnt, 0);
+    }
+    inline void update(const Layer* lay, bool wasOver, bool isOver);
+
+    unsigned size() const { return _members.size(); }
+    const vector<unsigned>& members() const { return _members; } // pool indices, unordered
+    unsigned gridCount(unsigned gridIdx) const { return _gridCnt[gridIdx]; }
+
+private:
+    const Layer*        _base;
+    unsigned            _layCnt;
+    vector<unsigned>    _members;
+    vector<unsigned>    _slot;    // pool idx -> position in _members, UINT_MAX if absent
+    vector<unsigned>    _gridCnt; // gGrid idx -> overflowed layers
+};
+
 // Multi Layer in a gGrid , i.e. layerGrid
 //-----------------------
 // Layer & gGrid class
@@ -163,36 +193,118 @@ class Layer
 public:
     Layer() : _supply(0) { _capacity = _supply; }
     ~Layer(){}
-    inline void setSupply(unsigned supply) { _supply = supply; _capacity = supply; }
-    inline void addDemand(int offset) { _capacity -= offset; }
-    inline void removeDemand(int offset) { _capacity += offset; }
-    inline unsigned getSupply() { return _supply; }
-    inline int getDemand() { return (((int)_supply) - _capacity);}
+    inline void setSupply(unsigned supply) { setCapacity(supply); _supply = supply; }
+    inline void addDemand(int offset) { setCapacity(_capacity - offset); }
+    inline void removeDemand(int offset) { setCapacity(_capacity + offset); }
+    inline unsigned getSupply() const { return _supply; }
+    inline int getDemand() const { return (((int)_supply) - _capacity);}
+    inline void setDemand(int demand) { setCapacity(((int)_supply) - demand); }
 
     void printSummary() const;
     GridStatus checkOverflow() const;
+    bool isOverflow() const { return _capacity < 0; }
+
+    static OverflowSet overflowSet;
 private:
+    inline void setCapacity(int capacity) {
+        if ((capacity < 0) != (_capacity < 0))
+            overflowSet.update(this, _capacity < 0, capacity < 0);
+        _capacity = capacity;
+    }
+
     unsigned _supply;
     int _capacity;  // supply - demand
 };
 
+inline void
+OverflowSet::update(const Layer* lay, bool wasOver, bool isOver)
+{
+    size_t idx = lay - _base;
+    if (!_base || lay < _base || idx >= _slot.size() || wasOver == isOver) return;
+    if (isOver) {
+        _slot[idx] = _members.size();
+        _members.push_back(idx);
+        ++_gridCnt[idx / _layCnt];
+    }
+    else {
+        unsigned s = _slot[idx], last = _members.back();
+        _members[s] = last;
+        _slot[last] = s;
+        _members.pop_back();
+        _slot[idx] = UINT_MAX;
+        --_gridCnt[idx / _layCnt];
+    }
+}
+
+// 2D supply, demand and congestion of every gGrid, row-major in
+// contiguous arrays. Demand is fixed point in 1/unit() of a track: unit()
+// is a multiple of every layer count a net can use, so the share a net
+// adds to a gGrid is an exact integer and removing the net restores the
+// demand bit for bit. Congestion is recomputed a whole row at a time on
+// the first read after the row changed.
+class Plane2D
+{
+public:
+    Plane2D() : _rows(0), _cols(0), _unit(1) {}
+    void init(unsigned rows, unsigned cols, unsigned layCnt);
+
+    int64_t unit() const { return _unit; }
+    int getSupply(unsigned idx) const { return _supply[idx]; }
+    void setSupply(unsigned idx, int supply) { _supply[idx] = supply; markRow(idx / _cols); }
+    int64_t getDemand(unsigned idx) const { return _demand[idx]; }
+    void setDemand(unsigned idx, int64_t demand) { _demand[idx] = demand; markRow(idx / _cols); }
+    void addDemand(unsigned idx, int64_t delta) {
+        assert(_supply[idx] > 0);
+        _demand[idx] += delta;
+        markRow(idx / _cols);
+    }
+    // delta on the cnt gGrids idx, idx+stride, idx+2*stride, ...
+    void addRun(unsigned idx, unsigned cnt, unsigned stride, int64_t delta);
+    double getCongestion(unsigned idx) {
+        unsigned r = idx / _cols;
+        if (_congStale[r]) updateRow(r);
+        return _congestion[idx];
+    }
+    // Rows whose demand or supply changed since the last call, for the
+    // consumers of congestion changes (RouteMgr::flushCongDirty())
+    bool takeRowTouched(unsigned r) {
+        if (!_rowTouched[r]) return false;
+        _rowTouched[r] = 0;
+        return true;
+    }
+    void clearRowTouched() { fill(_rowTouched.begin(), _rowTouched.end(), 0); }
+
+private:
+    void markRow(unsigned r) { _congStale[r] = 1; _rowTouched[r] = 1; }
+    void updateRow(unsigned r);
+
+    unsigned            _rows;
+    unsigned            _cols;
+    int64_t             _unit;
+    vector<int>         _supply;
+    vector<int64_t>     _demand;     // fixed point, in 1/_unit
+    vector<double>      _congestion; // valid unless the row is stale
+    vector<char>        _congStale;  // row -> _congestion needs updateRow()
+    vector<char>        _rowTouched; // row -> changed since takeRowTouched()
+};
+
 class Ggrid
 {
     friend CellInst;
 public:
-    Ggrid(Pos coord, unsigned layNum): _pos(coord), _2dSupply(0), _2dDemand(0), _2dCongestion(1) {
-        
-        initLayer(layNum);
+    Ggrid(Pos coord, Layer* layers, unsigned layNum): _pos(coord), _congDirty(false) {
+        _idx = (coord.first-1) * cEnd + (coord.second-1);
+        initLayer(layers, layNum);
     }
     ~Ggrid(){}
     Layer*& operator [] (unsigned layId) {
         assert(!_layerList.empty());
          return _layerList[layId-1]; }
-    inline void initLayer( unsigned layNum ){ 
+    // layers are owned by RouteMgr's contiguous layer pool
+    inline void initLayer( Layer* layers, unsigned layNum ){ 
         _layerList.resize(layNum); 
         for (unsigned i=0; i<layNum; ++i) {
-            Layer* newL = new Layer();
-            _layerList[i] = newL;
+            _layerList[i] = layers + i;
         }
     }
     static void setBoundary(unsigned rrBeg, unsigned ccBeg, unsigned rrEnd, unsigned ccEnd){ // [row][col]
@@ -201,26 +313,25 @@ public:
         rEnd = rrEnd;
         cEnd = ccEnd;
     }
-    void set2dSupply(int supply) { _2dSupply = supply; }
-    unsigned get2dSupply() const { return _2dSupply; }
-    unsigned get2dSupply() { return _2dSupply; }
-    double get2dDemand() const { return _2dDemand; }
-    double get2dDemand() { return _2dDemand; }
-    //double get2dCongestion() const {return _2dCongestion;}
-    double get2dCongestion() {return _2dCongestion;}
+    void set2dSupply(int supply) { plane2D.setSupply(_idx, supply); }
+    unsigned get2dSupply() const { return plane2D.getSupply(_idx); }
+    double get2dDemand() const { return (double)plane2D.getDemand(_idx) / plane2D.unit(); }
+    double get2dCongestion() { return plane2D.getCongestion(_idx); }
+    unsigned getIdx() const { return _idx; }
 
     void printSummary() const;
     void printCapacity() const;
     void printDemand() const;
-    void update2dDemand( double deltaDemand ) { 
-        assert(_2dSupply > 0);
-        _2dDemand = _2dDemand + deltaDemand;
+    // deltaDemand in whole tracks
+    void update2dDemand( int deltaDemand ) { 
         #ifdef DEBUG
         cout << "Grid (" << _pos.first << "," << _pos.second << ") delta demand " << deltaDemand << "\n"; 
         #endif
-        _2dCongestion = ((double)(_2dSupply) - (double)(_2dDemand)*CONGESTION_PARAMETER) / (double)(_2dSupply); 
+        plane2D.addDemand(_idx, deltaDemand * plane2D.unit());
     }
-    unsigned getOverflowCount() const;
+    // deltaDemand in 1/plane2D.unit() of a track
+    void update2dDemandFixed( int64_t deltaDemand ) { plane2D.addDemand(_idx, deltaDemand); }
+    unsigned getOverflowCount() const { return Layer::overflowSet.gridCount(_idx); }
     double koovaCongParam() {
         double gotcha = 0;
         for (auto m : _layerList) {
@@ -230,6 +341,15 @@ public:
         return gotcha / _layerList.size();
     }
     
+    void set2dDemand( double demand ) { plane2D.setDemand(_idx, llround(demand * plane2D.unit())); }
+    // Queue the gGrid once for RouteMgr::flushCongDirty() when its cells
+    // change; demand changes are tracked by the rows of plane2D
+    void markCongDirty() {
+        if (_congDirty) return;
+        _congDirty = true;
+        congDirtyList.push_back(this);
+    }
+    void clearCongDirty() { _congDirty = false; }
     void updatePos( Pos newpos ){
         _pos = newpos;
     }
@@ -239,15 +359,16 @@ public:
     static unsigned rEnd;
     static unsigned cBeg;
     static unsigned cEnd;
+    static vector<Ggrid*> congDirtyList;
+    static Plane2D plane2D;
 
     vector<CellInst*> cellInstList;
 private:
     Pos        _pos;
     LayerList  _layerList;
     InstList   _cellOnGridList;
-    unsigned   _2dSupply;
-    double     _2dDemand;
-    double     _2dCongestion;
+    unsigned   _idx; // (row-1)*cEnd+(col-1), into plane2D
+    bool       _congDirty; // in congDirtyList
 };
 
 //-------------------
@@ -328,8 +449,8 @@ public:
     bool checkOverflow();
     
     //Accessing functions
-    unsigned getMinLayCons() { return _minLayCons; }
-    set<PinPair> getPinSet() { return _pinSet; }
+    unsigned getMinLayCons() const { return _minLayCons; }
+    const set<PinPair>& getPinSet() const { return _pinSet; }
     unsigned getId() { return _netId; }
     bool shouldReroute() { return _toReroute; }
     bool findVCand(vector<int>&);
@@ -368,6 +489,8 @@ private:
     bool                _hasmovedbynb = false;
 };
 
+// Nets ordered by WL, longest first. A net whose segments change is
+// marked dirty by Net::ripUp(), and update() reranks only those nets.
 class NetRank
 {
     friend RouteMgr;
@@ -375,10 +498,24 @@ class NetRank
 public:
     void init();
     void update();
+    void load(const vector<PinPair>&);
+    void markDirty(unsigned netId) {
+        if (_isDirty[netId-1]) return;
+        _isDirty[netId-1] = true;
+        _dirtyNets.push_back(netId);
+    }
     void showTopTen() const;
     vector<unsigned> getTopTen() const;
 private:
-    vector<PinPair> NetWLpairs; // <netId, netTotWL>
+    struct RankCompare {
+        bool operator () (const PinPair& a, const PinPair& b) const {
+            return a.second > b.second || (a.second == b.second && a.first < b.first);
+        }
+    };
+    set<PinPair, RankCompare> NetWLpairs; // <netId, netTotWL>
+    vector<unsigned>    _netWL;     // netId-1 -> WL in NetWLpairs
+    vector<unsigned>    _dirtyNets; // netId
+    vector<bool>        _isDirty;   // netId-1 -> in _dirtyNets
 };
 
 #endif // ROUTE_NET_H
@@ -8,6 +8,7 @@
 
 #include <cassert>
 #include "routeMgr.h"
+#include "routeProf.h"
 #include "util.h"
 #include <algorithm>
 #include <csignal>
@@ -32,6 +33,7 @@ extern RouteMgr* routeMgr;
 #define FORCE_DIRECTED_INCREASE_RATIO 2.0 //force directed ratio increase per 10x max_move_count
 #define PRECISE_PnR_SKIP_RATIO 0.002
 #define PRECISE_PnR_SKIP_THRESHOLD 20
+#define MAIN_PnR_STALL_ROUNDS 1000 // rounds without a better WL before mainPnR gives up
 
 /**************************************************/
 /*   Public member functions about optimization   */
@@ -48,7 +50,18 @@ RouteMgr::mainPnR()
     #endif
     cout << "\nMain PnR...\n";
     unsigned reRouteCnt = 0;
+    unsigned stallCnt = 0;
     while(true){
+        if( stallCnt >= MAIN_PnR_STALL_ROUNDS ){
+            cout << "No improvement in " << stallCnt << " rounds!!" << endl;
+            cout << "P&R terminates..." << endl;
+            return;
+        }
+        if( timeUp() ){
+            cout << "Time limit reached!!" << endl;
+            cout << "P&R terminates..." << endl;
+            return;
+        }
         this->place();
         #ifdef DEBUG
         cout << "End of Placing..." << endl;
@@ -76,9 +89,11 @@ RouteMgr::mainPnR()
         _netRank->showTopTen();
         cout << "End of Routing..." << endl;
         #endif
+        unsigned lastWL = _bestTotalWL;
         if(canRoute == ROUTE_EXEC_DONE){
             replaceBest();
         }
+        stallCnt = (_bestTotalWL < lastWL) ? 0 : stallCnt + 1;
         
         this->_placeStrategy = (canRoute == ROUTE_EXEC_DONE) ? FORCE_DIRECTED : CONGESTION_BASED;
         #ifdef DEBUG
@@ -88,406 +103,512 @@ RouteMgr::mainPnR()
     }
 }
 
+// Half perimeter of the cells of a net, with cell moved to pos
+unsigned
+RouteMgr::netHPWL(Net* net, CellInst* cell, Pos pos) const
+{
+    unsigned rMin = Ggrid::rEnd, rMax = Ggrid::rBeg, cMin = Ggrid::cEnd, cMax = Ggrid::cBeg;
+    for(auto& cellPair : net->_assoCellInstMap){
+        CellInst* c = _instList[cellPair.first-1];
+        Pos p = (c == cell) ? pos : c->getPos();
+        rMin = min(rMin, p.first);  rMax = max(rMax, p.first);
+        cMin = min(cMin, p.second); cMax = max(cMax, p.second);
+    }
+    return (rMax - rMin) + (cMax - cMin);
+}
+
+// Order the cells precisePnR(strategy) tries. Each candidate is scored by
+// the HPWL reduction of its nets at the best of the positions that strategy
+// tries: the four neighbors of the cell for strategy 0, the pin centroid of
+// its nets and the four neighbors of that centroid for strategy 1. Equal
+// scores keep the old order, net by net and the most congested cell first.
+// A cell at its initial position costs one move of the budget, a cell sent
+// back home frees one. When the budget cannot cover every candidate, the
+// free and freeing cells go first, then the costly ones with the highest
+// gain; the budget is a knapsack with unit weights, so this is optimal.
+void
+RouteMgr::planPreciseMoves(vector<unsigned>& cells, bool strategy) const
+{
+    struct MoveGain { unsigned id; int gain; int cost; };
+    vector<MoveGain> cands;
+    vector<bool> counted(_instList.size(), false);
+    for(auto net : _targetNetList){
+        vector<pair<unsigned,double>> netCells; //first: cell index; second: cell grid congestion
+        for(auto& cellPair : net->_assoCellInstMap){
+            CellInst* cell = _instList[cellPair.first-1];
+            if(counted[cellPair.first-1] || !cell->is_movable() || cell->min_layer_constraint || cell->_hasmovedbyprecise)
+                continue;
+            counted[cellPair.first-1] = true;
+            netCells.push_back(pair<unsigned,double>(cellPair.first, cell->getGrid()->get2dCongestion()));
+        }
+        sort(netCells.begin(), netCells.end(), compare);
+
+        for(auto& cellPair : netCells){
+            CellInst* cell = _instList[cellPair.first-1];
+            Pos cur = cell->getPos();
+            Pos base = cur;
+            vector<Pos> trials;
+            if(strategy == 1){
+                // Same pin-weighted centroid as precisePnR()
+                double rNum = 0, cNum = 0, den = 0;
+                for(auto id : cell->assoNet){
+                    const set<PinPair>& pins = _netList[id-1]->getPinSet();
+                    int pinNum = pins.size() - 1;
+                    if(pinNum <= 0) continue;
+                    for(auto& pin : pins){
+                        if(_instList[pin.first-1] == cell) continue;
+                        rNum += (double)_instList[pin.first-1]->getPos().first / pinNum;
+                        cNum += (double)_instList[pin.first-1]->getPos().second / pinNum;
+                        den  += 1.0 / pinNum;
+                    }
+                }
+                if(den > 0){
+                    int r = (int)round(rNum / den), c = (int)round(cNum / den);
+                    r = min(max(r, (int)Ggrid::rBeg), (int)Ggrid::rEnd);
+                    c = min(max(c, (int)Ggrid::cBeg), (int)Ggrid::cEnd);
+                    base = Pos(r, c);
+                    trials.push_back(base);
+                }
+            }
+            trials.push_back(Pos(min(base.first+1, Ggrid::rEnd), base.second));
+            trials.push_back(Pos(max(base.first-1, Ggrid::rBeg), base.second));
+            trials.push_back(Pos(base.first, min(base.second+1, Ggrid::cEnd)));
+            trials.push_back(Pos(base.first, max(base.second-1, Ggrid::cBeg)));
+            int bestGain = INT_MIN;
+            Pos bestPos = cur;
+            for(auto& p : trials){
+                if(p == cur) continue;
+                int gain = 0;
+                for(auto id : cell->assoNet){
+                    Net* n = _netList[id-1];
+                    gain += (int)netHPWL(n, cell, cur) - (int)netHPWL(n, cell, p);
+                }
+                if(gain > bestGain){ bestGain = gain; bestPos = p; }
+            }
+            if(bestGain == INT_MIN) bestGain = 0;
+            Pos init = cell->getInitPos();
+            int cost = (cur == init) ? 1 : (bestPos == init ? -1 : 0);
+            cands.push_back(MoveGain{cellPair.first, bestGain, cost});
+        }
+    }
+    stable_sort(cands.begin(), cands.end(),
+                [](const MoveGain& a, const MoveGain& b) { return a.gain > b.gain; });
+
+    // Knapsack: unit-cost cells fill what the budget and the freed moves allow
+    int budget = (int)_maxMoveCnt - (int)getCurMoveCnt();
+    for(auto& m : cands)
+        if(m.cost < 0) ++budget;
+    vector<unsigned> deferred;
+    cells.clear();
+    for(auto& m : cands){
+        if(m.cost > 0 && budget <= 0){
+            deferred.push_back(m.id);
+            continue;
+        }
+        if(m.cost > 0) --budget;
+        cells.push_back(m.id);
+    }
+    // Rejected trials leave the budget unspent, so the rest may still run
+    cells.insert(cells.end(), deferred.begin(), deferred.end());
+    #ifdef DEBUG
+    cout << "Precise PnR plans " << cells.size() << " cells, " << deferred.size() << " over the move budget\n";
+    #endif
+}
+
 void 
 RouteMgr::precisePnR(bool strategy){
+    PROF_SCOPE(PROF_PRECISE_PNR);
     #ifdef DEBUG
     cout << "Initial WL : " << _bestTotalWL << endl;
     #endif
     cout << "\nPrecise PnR...\n";
     //sort(_targetNetList.begin(),_targetNetList.end(),compareLength);
-    //Try to move cells of target nets one by one
-    for(unsigned i=0;i<_targetNetList.size();++i){
+    //Try to move cells of target nets one by one, highest estimated gain first
+    vector<unsigned> moveCellList; //cell index
+    planPreciseMoves(moveCellList, strategy);
+    for(unsigned j=0;j<moveCellList.size();++j){
+        if( timeUp() ){
+            cout << "Time limit reached!!" << endl;
+            cout << "P&R terminates..." << endl;
+            return;
+        }
+        //A cell that has been moved can still be tried once the budget is used up
+        CellInst* moveCell = _instList[moveCellList[j]-1];
+        if( getCurMoveCnt() >= _maxMoveCnt && moveCell->getPos() == moveCell->getInitPos() )
+            continue;
         #ifdef DEBUG
-        cout << "PnR on net " << _targetNetList[i]->_netId << "...\n";
+        cout << "Move cell " << moveCell->getId() << "\n";
         #endif
-        //Add cells of the net and their 2d congestion to moveCellList, and sort by their congestion
-        vector<pair<unsigned,double>> moveCellList; //first: cell index; second: cell grid congestion
-        auto ite = _targetNetList[i]->_assoCellInstMap.begin();
-        for(unsigned j=0;j<_targetNetList[i]->_assoCellInstMap.size();++j){
-            if(_instList[ite->first-1]->is_movable() && _instList[ite->first-1]->min_layer_constraint == false && _instList[ite->first-1]->_hasmovedbyprecise == false)
-                moveCellList.push_back(pair<unsigned,double>(ite->first,_instList[ite->first-1]->getGrid()->get2dCongestion()));
-            ++ite;
+        moveCell->_hasmovedbyprecise = true;
+        vector< vector<Segment> > OOrigSegs, BestSegs;
+        bool recover = true, skip = false;
+
+        //store the original segments and position(x,y)
+        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+            vector<Segment> Segs;
+            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+            OOrigSegs.push_back(Segs);
         }
-        sort(moveCellList.begin(),moveCellList.end(),compare);
-        
-        //Try to move and route the cells one by one
-        for(unsigned j=0;j<moveCellList.size();++j){
-            if( getCurMoveCnt() >= _maxMoveCnt ){
-                cout << "Maximum cell-movements!!" << endl;
-                cout << "P&R terminates..." << endl;
-                return;
+        int cell_row = moveCell->getPos().first;
+        int cell_col = moveCell->getPos().second;
+        Pos curPos, bestPos;
+
+        if(strategy == 1){
+            //Calculate new position(x,y)
+            int new_row, new_col;
+            double row_numerator = 0;
+            double row_denominator = 0;
+            double col_numerator = 0;
+            double col_denominator = 0;
+            for(unsigned k=0; k<moveCell->assoNet.size(); ++k){
+                //cout << "Associated net " << _netList[moveCell->assoNet[i]-1]->_netId << "\n";
+                int pin_num = _netList[moveCell->assoNet[k]-1]->getPinSet().size() - 1;
+                std::set<PinPair>::iterator it = _netList[moveCell->assoNet[k]-1]->getPinSet().begin();
+                if(pin_num > 0){
+                    for(int l=0; l<pin_num+1; ++l){
+                        if(_instList[(*it).first-1] != moveCell){
+                            //cout << _instList[(*it).first-1]->getPos().first << " " << _instList[(*it).first-1]->getPos().second << "\n";
+                            //cout << "Pin_num: " << (double)pin_num << "\n";
+                            row_numerator += ((double)(_instList[(*it).first-1]->getPos().first))/((double)(pin_num));
+                            col_numerator += ((double)(_instList[(*it).first-1]->getPos().second))/((double)(pin_num));
+                            row_denominator += 1.0/((double)(pin_num));
+                            col_denominator += 1.0/((double)(pin_num));
+                        }
+                        ++it;
+                    }
+                }
+                //_netList[moveCell->assoNet[k]-1]->_toRemoveDemand = true;
             }
+            //calculate new position
+            new_row = (int)(round((double)(row_numerator) / (double)(row_denominator)));
+            new_col = (int)(round((double)(col_numerator) / (double)(col_denominator)));
+            if(new_row > (int)Ggrid::rEnd)
+                new_row = Ggrid::rEnd;
+            else if(new_row < (int)Ggrid::rBeg)
+                new_row = Ggrid::rBeg;
+            if(new_col > (int)Ggrid::cEnd)
+                new_col = Ggrid::cEnd;
+            else if(new_col < (int)Ggrid::cBeg)
+                new_col = Ggrid::cBeg;
             
-            CellInst* moveCell = _instList[moveCellList[j].first-1];
             #ifdef DEBUG
-            cout << "Move cell " << moveCell->getId() << "\n";
+            cout << "Start with ";
+            checkOverflow();
             #endif
-            moveCell->_hasmovedbyprecise = true;
-            vector< vector<Segment> > OOrigSegs, BestSegs;
-            bool recover = true, skip = false;
-
-            //store the original segments and position(x,y)
-            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                vector<Segment> Segs;
-                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                OOrigSegs.push_back(Segs);
-            }
-            int cell_row = moveCell->getPos().first;
-            int cell_col = moveCell->getPos().second;
-            Pos curPos, bestPos;
+            
+            //move cell to newPos and route
+            curPos = pair<unsigned,unsigned>(new_row,new_col);
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
 
-            if(strategy == 1){
-                //Calculate new position(x,y)
-                int new_row, new_col;
-                double row_numerator = 0;
-                double row_denominator = 0;
-                double col_numerator = 0;
-                double col_denominator = 0;
-                for(unsigned k=0; k<moveCell->assoNet.size(); ++k){
-                    //cout << "Associated net " << _netList[moveCell->assoNet[i]-1]->_netId << "\n";
-                    int pin_num = _netList[moveCell->assoNet[k]-1]->getPinSet().size() - 1;
-                    std::set<PinPair>::iterator it = _netList[moveCell->assoNet[k]-1]->getPinSet().begin();
-                    if(pin_num > 0){
-                        for(int l=0; l<pin_num+1; ++l){
-                            if(_instList[(*it).first-1] != moveCell){
-                                //cout << _instList[(*it).first-1]->getPos().first << " " << _instList[(*it).first-1]->getPos().second << "\n";
-                                //cout << "Pin_num: " << (double)pin_num << "\n";
-                                row_numerator += ((double)(_instList[(*it).first-1]->getPos().first))/((double)(pin_num));
-                                col_numerator += ((double)(_instList[(*it).first-1]->getPos().second))/((double)(pin_num));
-                                row_denominator += 1.0/((double)(pin_num));
-                                col_denominator += 1.0/((double)(pin_num));
-                            }
-                            ++it;
+                        //vector< vector<Segment> > CurSegs;
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
-                    //_netList[moveCell->assoNet[k]-1]->_toRemoveDemand = true;
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD )
+                        skip = true;
                 }
-                //calculate new position
-                new_row = (int)(round((double)(row_numerator) / (double)(row_denominator)));
-                new_col = (int)(round((double)(col_numerator) / (double)(col_denominator)));
-                if(new_row > (int)Ggrid::rEnd)
-                    new_row = Ggrid::rEnd;
-                else if(new_row < (int)Ggrid::rBeg)
-                    new_row = Ggrid::rBeg;
-                if(new_col > (int)Ggrid::cEnd)
-                    new_col = Ggrid::cEnd;
-                else if(new_col < (int)Ggrid::cBeg)
-                    new_col = Ggrid::cBeg;
-                
-                #ifdef DEBUG
-                cout << "Start with ";
-                checkOverflow();
-                #endif
-                
-                //move cell to newPos and route
-                curPos = pair<unsigned,unsigned>(new_row,new_col);
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+            }
+
+            //move cell to (x+1,y) and route
+            curPos = pair<unsigned,unsigned>(min(new_row+1,(int)Ggrid::rEnd),new_col);
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD )
-                            skip = true;
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD )//PRECISE_PnR_SKIP_RATIO*_bestTotalWL
+                        skip = true;
                 }
+            }
+            
+            //move cell to (x-1,y) and route
+            curPos = pair<unsigned,unsigned>(max(new_row-1,(int)Ggrid::rBeg),new_col);
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
 
-                //move cell to (x+1,y) and route
-                curPos = pair<unsigned,unsigned>(min(new_row+1,(int)Ggrid::rEnd),new_col);
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+                        //vector< vector<Segment> > CurSegs;
+                        BestSegs.resize(0);
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD )//PRECISE_PnR_SKIP_RATIO*_bestTotalWL
-                            skip = true;
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
+                        skip = true;
                 }
-                
-                //move cell to (x-1,y) and route
-                curPos = pair<unsigned,unsigned>(max(new_row-1,(int)Ggrid::rBeg),new_col);
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            BestSegs.resize(0);
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+            }
+            
+            //move cell to (x,y+1) and route
+            curPos = pair<unsigned,unsigned>(new_row,min(new_col+1,(int)Ggrid::cEnd));
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        BestSegs.resize(0);
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
-                            skip = true;
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
+                        skip = true;
                 }
-                
-                //move cell to (x,y+1) and route
-                curPos = pair<unsigned,unsigned>(new_row,min(new_col+1,(int)Ggrid::cEnd));
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            BestSegs.resize(0);
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+            }
+            
+            //move cell to (x,y-1) and route
+            curPos = pair<unsigned,unsigned>(new_row,max(new_col-1,(int)Ggrid::cBeg));
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        BestSegs.resize(0);
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
-                            skip = true;
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
                 }
-                
-                //move cell to (x,y-1) and route
-                curPos = pair<unsigned,unsigned>(new_row,max(new_col-1,(int)Ggrid::cBeg));
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            BestSegs.resize(0);
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+            }
+        }
+        else{
+            //move cell to (x+1,y) and route
+            curPos = pair<unsigned,unsigned>(min(cell_row+1,(int)Ggrid::rEnd),cell_col);
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
+                Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
+                if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
+                    canRoute = ROUTE_EXEC_ERROR;
+                }
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD )//PRECISE_PnR_SKIP_RATIO*_bestTotalWL
+                        skip = true;
                 }
             }
-            else{
-                //move cell to (x+1,y) and route
-                curPos = pair<unsigned,unsigned>(min(cell_row+1,(int)Ggrid::rEnd),cell_col);
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
-                    Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
-                    if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
-                        canRoute = ROUTE_EXEC_ERROR;
-                    }
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
-                        }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD )//PRECISE_PnR_SKIP_RATIO*_bestTotalWL
-                            skip = true;
-                    }
+            
+            //move cell to (x-1,y) and route
+            curPos = pair<unsigned,unsigned>(max(cell_row-1,(int)Ggrid::rBeg),cell_col);
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
+                Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
+                if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
+                    canRoute = ROUTE_EXEC_ERROR;
                 }
-                
-                //move cell to (x-1,y) and route
-                curPos = pair<unsigned,unsigned>(max(cell_row-1,(int)Ggrid::rBeg),cell_col);
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
-                    Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
-                    if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
-                        canRoute = ROUTE_EXEC_ERROR;
-                    }
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            BestSegs.resize(0);
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        BestSegs.resize(0);
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
-                            skip = true;
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
+                        skip = true;
                 }
-                
-                //move cell to (x,y+1) and route
-                curPos = pair<unsigned,unsigned>(cell_row,min(cell_col+1,(int)Ggrid::cEnd));
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
-                    Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
-                    if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
-                        canRoute = ROUTE_EXEC_ERROR;
-                    }
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            BestSegs.resize(0);
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+            }
+            
+            //move cell to (x,y+1) and route
+            curPos = pair<unsigned,unsigned>(cell_row,min(cell_col+1,(int)Ggrid::cEnd));
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
+                Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
+                if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
+                    canRoute = ROUTE_EXEC_ERROR;
+                }
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        BestSegs.resize(0);
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
-                        else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
-                            skip = true;
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
+                    else if((newWL - _bestTotalWL) > PRECISE_PnR_SKIP_THRESHOLD)
+                        skip = true;
                 }
-                
-                //move cell to (x,y-1) and route
-                curPos = pair<unsigned,unsigned>(cell_row,max(cell_col-1,(int)Ggrid::cBeg));
-                if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
-                    moveOneCell(moveCellList[j].first, curPos, 3);
-                    RouteExecStatus canRoute = this->route();
-                    Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
-                    Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
-                    if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
-                        canRoute = ROUTE_EXEC_ERROR;
-                    }
-                    if(canRoute == ROUTE_EXEC_DONE){
-                        unsigned newWL = evaluateWireLen();
-                        _netRank->update();
-                        if(newWL < _bestTotalWL){
-                            storeBestResult();
-                            _bestTotalWL = newWL;
-                            recover = false;
-                            bestPos = curPos;
-
-                            //vector< vector<Segment> > CurSegs;
-                            BestSegs.resize(0);
-                            for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                                vector<Segment> Segs;
-                                for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
-                                BestSegs.push_back(Segs);
-                            }
-                            //BestSegs = CurSegs;
-                            cout << _bestTotalWL << " is a Better Solution!!\n";
+            }
+            
+            //move cell to (x,y-1) and route
+            curPos = pair<unsigned,unsigned>(cell_row,max(cell_col-1,(int)Ggrid::cBeg));
+            if(_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() == 0 && skip == false && curPos != pair<unsigned,unsigned>(cell_row,cell_col)){
+                moveOneCell(moveCellList[j], curPos, 3);
+                RouteExecStatus canRoute = this->route();
+                Pos nxtHPos = pair<unsigned,unsigned>(curPos.first, min(curPos.second+1,Ggrid::cEnd));
+                Pos prevHPos = pair<unsigned,unsigned>(curPos.first, max(curPos.second-1,Ggrid::cBeg));
+                if((_gridList[curPos.first-1][curPos.second-1]->getOverflowCount() != 0) || (_gridList[nxtHPos.first-1][nxtHPos.second-1]->getOverflowCount() != 0) || (_gridList[prevHPos.first-1][prevHPos.second-1]->getOverflowCount() != 0)){
+                    canRoute = ROUTE_EXEC_ERROR;
+                }
+                if(canRoute == ROUTE_EXEC_DONE){
+                    unsigned newWL = evaluateWireLen();
+                    _netRank->update();
+                    if(newWL < _bestTotalWL){
+                        storeBestResult();
+                        _bestTotalWL = newWL;
+                        recover = false;
+                        bestPos = curPos;
+
+                        //vector< vector<Segment> > CurSegs;
+                        BestSegs.resize(0);
+                        for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                            vector<Segment> Segs;
+                            for (auto s : _netList[moveCell->assoNet[k]-1]->_netSegs) { Segs.push_back(*s); }
+                            BestSegs.push_back(Segs);
                         }
+                        //BestSegs = CurSegs;
+                        cout << _bestTotalWL << " is a Better Solution!!\n";
                     }
                 }
             }
-            
-            //If some of the move and route above improve the wirelength, replace with the better routing result; otherwise, restore the original routing segments
-            if(recover == true) {
-                moveOneCell(moveCellList[j].first, Pos(cell_row,cell_col), 3);
+        }
+        
+        //If some of the move and route above improve the wirelength, replace with the better routing result; otherwise, restore the original routing segments
+        if(recover == true) {
+            moveOneCell(moveCellList[j], Pos(cell_row,cell_col), 3);
+            for(unsigned k=0;k<moveCell->assoNet.size();++k){
+                Net* n = _netList[moveCell->assoNet[k]-1];
+                if(!n->_netSegs.empty())
+                    remove3DDemand(n);
+                n->ripUp();
+                n->shouldReroute(false);
+                for (auto s : OOrigSegs[k]) {
+                    Segment* seg = new Segment(s);
+                    n->_netSegs.push_back(seg);
+                }
+                add3DDemand(n);
+            }
+        }
+        else {
+            if(bestPos != curPos){
+                moveOneCell(moveCellList[j], bestPos, 3);
                 for(unsigned k=0;k<moveCell->assoNet.size();++k){
                     Net* n = _netList[moveCell->assoNet[k]-1];
                     if(!n->_netSegs.empty())
                         remove3DDemand(n);
                     n->ripUp();
                     n->shouldReroute(false);
-                    for (auto s : OOrigSegs[k]) {
+                    for (auto s : BestSegs[k]) {
                         Segment* seg = new Segment(s);
                         n->_netSegs.push_back(seg);
                     }
                     add3DDemand(n);
                 }
             }
-            else {
-                if(bestPos != curPos){
-                    moveOneCell(moveCellList[j].first, bestPos, 3);
-                    for(unsigned k=0;k<moveCell->assoNet.size();++k){
-                        Net* n = _netList[moveCell->assoNet[k]-1];
-                        if(!n->_netSegs.empty())
-                            remove3DDemand(n);
-                        n->ripUp();
-                        n->shouldReroute(false);
-                        for (auto s : BestSegs[k]) {
-                            Segment* seg = new Segment(s);
-                            n->_netSegs.push_back(seg);
-                        }
-                        add3DDemand(n);
-                    }
-                }
-            }
+        }
+        routeProf.count(recover ? PROF_PRECISE_REJECT : PROF_PRECISE_ACCEPT);
+        if(recover == false){
+            saveCheckpoint();
+            publishBest();
         }
     }
 
@@ -496,6 +617,89 @@ RouteMgr::precisePnR(bool strategy){
     }
 }
 
+// Run the PnR phases as long as the time budget allows. The cost of the
+// next phase is estimated from the throughput observed on its last run, and
+// a phase that does not fit the remaining time is skipped.
+void
+RouteMgr::schedulePnR()
+{
+    cout << "\nTime budget " << _timeBudget << " s, elapsed " << getElapsedTime() << " s\n";
+    scheduleReroute();
+    scheduleReroute();
+    if(getCellCnt() > 100){
+        schedulePreciseRounds();
+    }
+    else{
+        mainPnR();
+    }
+    // Global moves out of the local minimum the greedy phases stop at
+    if(scheduleAnneal() && getCellCnt() > 100)
+        scheduleReroute();
+    cout << "PnR done, elapsed " << getElapsedTime() << " s\n";
+}
+
+// Alternate two precisePnR() passes and a reroute while the WL improves
+void
+RouteMgr::schedulePreciseRounds()
+{
+    unsigned lastWL;
+    do {
+        lastWL = _bestTotalWL;
+        if(!schedulePrecisePnR() || !schedulePrecisePnR())
+            break;
+        if(getCurMoveCnt() >= _maxMoveCnt || !scheduleReroute())
+            break;
+    } while(_bestTotalWL < lastWL);
+}
+
+bool
+RouteMgr::scheduleReroute()
+{
+    double estimate = _rerouteRate * _netList.size();
+    if(timeUp() || estimate > getRemainingTime()){
+        cout << "Skip rerouting, estimated " << estimate << " s, remaining " << getRemainingTime() << " s\n";
+        return false;
+    }
+    double start = getElapsedTime();
+    reroute();
+    if(!_netList.empty())
+        _rerouteRate = (getElapsedTime() - start) / _netList.size();
+    return true;
+}
+
+bool
+RouteMgr::schedulePrecisePnR()
+{
+    unsigned workload = preciseWorkload();
+    double estimate = _preciseRate * workload;
+    if(workload == 0 || timeUp() || estimate > getRemainingTime()){
+        cout << "Skip precise PnR, estimated " << estimate << " s, remaining " << getRemainingTime() << " s\n";
+        return false;
+    }
+    double start = getElapsedTime();
+    precisePnR(0);
+    _preciseRate = (getElapsedTime() - start) / workload;
+    return true;
+}
+
+// Number of cells precisePnR() will try on the current target nets
+unsigned
+RouteMgr::preciseWorkload() const
+{
+    vector<bool> counted(_instList.size(), false);
+    unsigned workload = 0;
+    for(auto net : _targetNetList){
+        for(auto& cellPair : net->_assoCellInstMap){
+            CellInst* cell = _instList[cellPair.first-1];
+            if(counted[cellPair.first-1] || !cell->is_movable() || cell->min_layer_constraint)
+                continue;
+            counted[cellPair.first-1] = true;
+            ++workload;
+        }
+    }
+    return workload;
+}
+
 void 
 RouteMgr::place()
 {
@@ -697,6 +901,47 @@ RouteMgr::netbasedPlace(){
     }
 }
 
+// Candidates of forcedirectedPlace(): movable cells not moved by it yet,
+// keyed by the 2D congestion of their gGrid
+void
+RouteMgr::buildFdHeap()
+{
+    _fdHeap.reset(_instList.size());
+    for(unsigned i=0;i<_instList.size();++i){
+        CellInst* cell = _instList[i];
+        if(cell->is_movable() && !cell->_hasmovedbyfd && !cell->min_layer_constraint)
+            _fdHeap.push(i, cell->getGrid()->get2dCongestion());
+    }
+    for(auto g : Ggrid::congDirtyList)
+        g->clearCongDirty();
+    Ggrid::congDirtyList.clear();
+    Ggrid::plane2D.clearRowTouched();
+    _fdHeapBuilt = true;
+}
+
+// Rekey the candidates on the gGrids whose congestion or cells changed
+// since the last call
+void
+RouteMgr::flushCongDirty()
+{
+    for(unsigned r=Ggrid::rBeg; r<=Ggrid::rEnd; ++r){
+        if(!Ggrid::plane2D.takeRowTouched(r-1))
+            continue;
+        for(auto g : _gridList[r-1])
+            if(!g->cellInstList.empty())
+                g->markCongDirty();
+    }
+    for(auto g : Ggrid::congDirtyList){
+        g->clearCongDirty();
+        for(auto cell : g->cellInstList){
+            unsigned idx = cell->getId() - 1;
+            if(_fdHeap.contains(idx))
+                _fdHeap.update(idx, g->get2dCongestion());
+        }
+    }
+    Ggrid::congDirtyList.clear();
+}
+
 void 
 RouteMgr::forcedirectedPlace (){
     #ifdef DEBUG
@@ -704,51 +949,55 @@ RouteMgr::forcedirectedPlace (){
     #endif
 
     vector<CellInst*> moveCells;
-    vector<pair<unsigned,double>> congestionList; //first: cellInst index; second: 2d_congestion
-    for(unsigned i=0;i<_instList.size();++i){
-        congestionList.push_back(pair<unsigned,double>(i+1,_instList[i]->getGrid()->get2dCongestion()));
-    }
-    sort(congestionList.begin(), congestionList.end(), compare);
-    #ifdef DEBUG
-    for(unsigned i=0;i<congestionList.size();++i){
-        cout << "CellInst " << congestionList[i].first << " with congestion " << congestionList[i].second << "\n";
-    }
-    #endif
-    unsigned i = 0;
+    if(!_fdHeapBuilt)
+        buildFdHeap();
+    else
+        flushCongDirty();
     //unsigned move_cell_num = ceil((double)_maxMoveCnt/(double)FORCE_DIRECTED_BASE_RATIO);
-    unsigned move_cell_num = 1/*moveCellNum()*/;
+    unsigned move_cell_num = _placeBatch/*moveCellNum()*/;
     #ifdef DEBUG
     cout << "move_cell_num = " << move_cell_num << "\n";
     #endif
-    while(moveCells.size() < move_cell_num){
-        if(i == _instList.size()-1){
-            if(_instList[congestionList[i].first-1]->is_movable() && (_instList[congestionList[i].first-1]->_hasmovedbyfd == false) && (_instList[congestionList[i].first-1]->min_layer_constraint == false)){
-                moveCells.push_back(_instList[congestionList[i].first-1]);
-                for(unsigned j=0;j<_instList[congestionList[i].first-1]->assoNet.size();++j){
-                    if(_netList[_instList[congestionList[i].first-1]->assoNet[j]-1]->_routable == false){
-                        moveCells.pop_back();
-                        break;
-                    }
-                }
-                for(unsigned j=0;j<_instList.size();++j)
-                    _instList[j]->_hasmovedbyfd = false;
-                break;
-            }
-            for(unsigned j=0;j<_instList.size();++j){
-                _instList[j]->_hasmovedbyfd = false;
-            }
-            break;
+    // Most congested first; cells on unroutable nets are skipped this time
+    // only. A batch is an independent set: no two cells share a net, so one
+    // route() reroutes every affected net once. The extra cells of a batch
+    // never take the moved-cell count past MaxCellMove.
+    vector<unsigned> skipped;
+    vector<int> batchNets;
+    unsigned newMoveCnt = 0;
+    const unsigned maxTries = move_cell_num * 8;
+    for(unsigned tries=0; moveCells.size() < move_cell_num && !_fdHeap.empty(); ++tries){
+        if(!moveCells.empty() && tries >= maxTries) break;
+        unsigned idx = _fdHeap.pop();
+        CellInst* cell = _instList[idx];
+        bool pick = true;
+        for(unsigned j=0;j<cell->assoNet.size() && pick;++j){
+            if(_netList[cell->assoNet[j]-1]->_routable == false)
+                pick = false;
+            else if(find(batchNets.begin(), batchNets.end(), cell->assoNet[j]) != batchNets.end())
+                pick = false;
         }
-        if(_instList[congestionList[i].first-1]->is_movable() && (_instList[congestionList[i].first-1]->_hasmovedbyfd == false) && (_instList[congestionList[i].first-1]->min_layer_constraint == false)){
-            moveCells.push_back(_instList[congestionList[i].first-1]);
-            for(unsigned j=0;j<_instList[congestionList[i].first-1]->assoNet.size();++j){
-                if(_netList[_instList[congestionList[i].first-1]->assoNet[j]-1]->_routable == false){
-                    moveCells.pop_back();
-                    break;
-                }
-            }
+        bool newMove = (cell->getPos() == cell->getInitPos());
+        if(pick && !moveCells.empty() && newMove && getCurMoveCnt() + newMoveCnt + 1 > _maxMoveCnt)
+            pick = false;
+        if(!pick){
+            skipped.push_back(idx);
+            continue;
         }
-        ++i;
+        moveCells.push_back(cell);
+        batchNets.insert(batchNets.end(), cell->assoNet.begin(), cell->assoNet.end());
+        if(newMove) ++newMoveCnt;
+    }
+    bool exhausted = _fdHeap.empty();
+    for(auto idx : skipped)
+        _fdHeap.push(idx, _instList[idx]->getGrid()->get2dCongestion());
+    if(exhausted && moveCells.size() < move_cell_num){
+        // Every candidate has been tried, start over
+        for(unsigned j=0;j<_instList.size();++j)
+            _instList[j]->_hasmovedbyfd = false;
+        buildFdHeap();
+        for(auto cell : moveCells)
+            _fdHeap.erase(cell->getId() - 1);
     }
     #ifdef DEBUG
     for(unsigned i=0;i<moveCells.size();++i){
@@ -868,14 +1117,15 @@ RouteMgr::moveCellNum() {
 
 void
 RouteMgr::moveOneCell(unsigned id, Pos newPos, unsigned type){ 
+    PROF_SCOPE(PROF_MOVE_CELL);
     //type = 0 : random cell, random pos; type = 1 : random cell, assigned pos; type = 2 : assigned cell, random pos; type : assigned cell, assigned pos
     int new_row, new_col, cellId;
     if(type == 0){
         do{
             cellId = rnGen(_instList.size()) + 1;
         }while(_instList[cellId-1]->is_movable() == false || _instList[cellId-1]->min_layer_constraint == true);
-        new_row = Ggrid::rBeg + rnGen(Ggrid::rEnd - Ggrid::rBeg);
-        new_col = Ggrid::cBeg + rnGen(Ggrid::cEnd - Ggrid::cBeg);
+        new_row = Ggrid::rBeg + rnGen(Ggrid::rEnd - Ggrid::rBeg + 1);
+        new_col = Ggrid::cBeg + rnGen(Ggrid::cEnd - Ggrid::cBeg + 1);
     }
     else if(type == 1){
         do{
@@ -898,8 +1148,8 @@ RouteMgr::moveOneCell(unsigned id, Pos newPos, unsigned type){
             return;
         }
         else cellId = id;
-        new_row = Ggrid::rBeg + rnGen(Ggrid::rEnd - Ggrid::rBeg);
-        new_col = Ggrid::cBeg + rnGen(Ggrid::cEnd - Ggrid::cBeg);
+        new_row = Ggrid::rBeg + rnGen(Ggrid::rEnd - Ggrid::rBeg + 1);
+        new_col = Ggrid::cBeg + rnGen(Ggrid::cEnd - Ggrid::cBeg + 1);
     }
     else{
         if(id > _instList.size() || id <= 0){
@@ -1263,6 +1513,7 @@ RouteMgr::errorOption(RouteExecError rError)
 RouteExecStatus
 RouteMgr::layerassign(Net* net)
 {
+    PROF_SCOPE(PROF_LAYERASSIGN);
     //cout << "\nLayerAssign...\n";
     vector<Segment*> toDel;
     //unsigned maxLayer = _laySupply.size();
@@ -1288,6 +1539,25 @@ RouteMgr::layerassign(Net* net)
             vector<int> candidates;
             
             if (!i) { curLayer = seg->startPos[2]; }
+            else if (seg->startPos[0] != net->_netSegs[i-1]->endPos[0] ||
+                     seg->startPos[1] != net->_netSegs[i-1]->endPos[1]) {
+                // A path of route2D() starts from the middle of the tree,
+                // continue from a layer already assigned at that gGrid
+                for (unsigned j=0; j<net->_netSegs.size(); ++j) {
+                    if (j >= i && j < segCnt) continue;
+                    Segment* t = net->_netSegs[j];
+                    if (min(t->startPos[0], t->endPos[0]) <= seg->startPos[0] &&
+                        max(t->startPos[0], t->endPos[0]) >= seg->startPos[0] &&
+                        min(t->startPos[1], t->endPos[1]) <= seg->startPos[1] &&
+                        max(t->startPos[1], t->endPos[1]) >= seg->startPos[1]) {
+                        curLayer = t->startPos[2];
+                        break;
+                    }
+                }
+            }
+            // A via to a pin on the tree starts from the current layer
+            if (!seg->startPos[2] && seg->startPos[0] == seg->endPos[0] && seg->startPos[1] == seg->endPos[1])
+                seg->startPos[2] = curLayer;
 
             // Z
             if (seg->checkDir() == DIR_Z)
@@ -1400,6 +1670,7 @@ RouteMgr::layerassign(Net* net)
                         set<Layer*> newZGrids = newZSeg.newGrid(net, myAlpha);
                         for (auto zg : newZGrids) { newGrids.insert(zg); }
                         for (auto g : newGrids) { g->addDemand(1); }
+                        routeProf.count(PROF_LA_CAND);
                         if (!newSeg.checkOverflow() && !newZSeg.checkOverflow()) {
                             if (newGrids.size() < newLength) {
                                 newLength = newGrids.size();
@@ -1407,6 +1678,7 @@ RouteMgr::layerassign(Net* net)
                             }
                             //diff = ((diff) < (j-curLayer)) ? diff : j-curLayer;
                         }
+                        else routeProf.count(PROF_LA_OVERFLOW);
                         for (auto g : newGrids) { g->removeDemand(1); }
                     }
                     if (diff == INT16_MAX) {
@@ -1438,6 +1710,7 @@ RouteMgr::layerassign(Net* net)
                         set<Layer*> newZGrids = newZSeg.newGrid(net, myAlpha);
                         for (auto zg : newZGrids) { newGrids.insert(zg); }
                         for (auto g : newGrids) { g->addDemand(1); }
+                        routeProf.count(PROF_LA_CAND);
                         if (!newSeg.checkOverflow() && !newZSeg.checkOverflow()) {
                             if (newGrids.size() < newLength) {
                                 newLength = newGrids.size();
@@ -1445,6 +1718,7 @@ RouteMgr::layerassign(Net* net)
                             }
                             //diff = ((diff) < (j-curLayer)) ? diff : j-curLayer;
                         }
+                        else routeProf.count(PROF_LA_OVERFLOW);
                         for (auto g : newGrids) { g->removeDemand(1); }
                     }
                     if (diff == INT16_MAX) {
@@ -1491,7 +1765,7 @@ RouteMgr::layerassign(Net* net)
                 }
             }
             
-            if (seg->endPos[2] && i == segCnt-1) {
+            if (seg->endPos[2]) { // end of a path at a pin
                 #ifdef DEBUG
                 cout << "Last Seg ";
                 seg->print();
@@ -0,0 +1,268 @@
+/****************************************************************************
+  FileName     [ routePortfolio.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define the process-level portfolio of PnR strategies ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <new>
+#include <climits>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "routeMgr.h"
+#include "rnGen.h"
+#include "util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+#define PORTFOLIO_POLL_US  20000 // microseconds between two looks at the workers
+#define PORTFOLIO_GRACE    10.0  // seconds past the budget before workers are killed
+
+enum PortfolioStrategy
+{
+    PF_DEFAULT,  // schedulePnR(), the flow picked by the cell count
+    PF_REROUTE,  // reroute only, no cell is moved
+    PF_PRECISE,  // precisePnR() rounds whatever the cell count
+    PF_MAIN,     // mainPnR() whatever the cell count
+    PF_ANNEAL,   // annealing slices, each followed by a reroute
+
+    PF_STRATEGY_TOT
+};
+
+static const char* pfName[PF_STRATEGY_TOT] = {
+    "default", "reroute", "precise", "main", "anneal"
+};
+
+// One slot per worker in an anonymous shared mapping
+struct PortfolioSlot
+{
+    atomic<unsigned> bestWL; // the worker's file holds a result at least this good
+    atomic<unsigned> done;   // bestWL is final
+};
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+static bool
+writeAll(int fd, const char* p, size_t left)
+{
+    while (left) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n; left -= n;
+    }
+    return true;
+}
+
+/*************************************/
+/*   class RouteMgr member functions */
+/*************************************/
+// Run workers PnR strategies side by side on the design read once. Worker
+// 0 is this process and runs the default flow; workers 1.. are forked and
+// share the design copy-on-write, each with its own strategy and random
+// stream. Whenever a worker finds a better result it publishes the output
+// to spoolBase.w<idx> and then its WL to shared memory, so a worker that is
+// killed at the deadline still leaves its best, and the emergency dump can
+// pick it. The best worker result is finally read back into the nets and
+// the best state of this process, as if this process had found it.
+void
+RouteMgr::schedulePortfolio(unsigned workers, const string& spoolBase)
+{
+    if (workers <= 1) { schedulePnR(); return; }
+
+    size_t mapSize = workers * sizeof(PortfolioSlot);
+    void* map = mmap(0, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        cerr << "Portfolio shared memory failed, run the default flow only\n";
+        schedulePnR();
+        return;
+    }
+    PortfolioSlot* slots = new (map) PortfolioSlot[workers];
+    for (unsigned w=0; w<workers; ++w) { slots[w].bestWL = UINT_MAX; slots[w].done = 0; }
+    // Sized before the first fork, the signal handler may read them any time
+    _pfPids.assign(workers, 0);
+    _pfFiles.resize(workers);
+    _pfTmpFiles.resize(workers);
+    for (unsigned w=1; w<workers; ++w) {
+        _pfFiles[w] = spoolBase + ".w" + to_string(w);
+        _pfTmpFiles[w] = _pfFiles[w] + ".tmp";
+    }
+    _pfWorkers = workers;
+    _pfSlots = slots;
+
+    cout << "\nPortfolio of " << workers << " workers\n";
+    cout.flush();
+    for (unsigned w=1; w<workers; ++w) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Leave the emergency output and the checkpoint to the parent
+            signal(SIGINT, SIG_DFL);
+            signal(SIGSEGV, SIG_DFL);
+            _ckptFile.clear();
+            _ckptPid = 0;
+            _pfSelf = w;
+            #ifndef DEBUG
+            int devNull = open("/dev/null", O_WRONLY);
+            if (devNull >= 0) { dup2(devNull, STDOUT_FILENO); close(devNull); }
+            #endif
+            for (unsigned k=0; k<w; ++k) rnGen.jump();
+
+            switch (w % PF_STRATEGY_TOT) {
+                case PF_REROUTE: {
+                    unsigned lastWL;
+                    do { lastWL = _bestTotalWL; }
+                    while (scheduleReroute() && _bestTotalWL < lastWL);
+                    break;
+                }
+                case PF_PRECISE:
+                    scheduleReroute();
+                    scheduleReroute();
+                    schedulePreciseRounds();
+                    break;
+                case PF_MAIN:
+                    scheduleReroute();
+                    scheduleReroute();
+                    mainPnR();
+                    break;
+                case PF_ANNEAL:
+                    scheduleReroute();
+                    while (scheduleAnneal())
+                        scheduleReroute();
+                    break;
+                default:
+                    schedulePnR();
+                    break;
+            }
+            publishBest();
+            slots[w].done = 1;
+            _exit(0);
+        }
+        if (pid < 0) break;
+        _pfPids[w] = pid;
+    }
+
+    schedulePnR();
+    slots[0].bestWL = _bestTotalWL;
+    slots[0].done = 1;
+
+    // Wait until every worker is done or gone, then stop the stragglers;
+    // what they published so far still counts
+    unsigned running = 0;
+    for (unsigned w=1; w<workers; ++w)
+        if (_pfPids[w] > 0) ++running;
+    while (running) {
+        for (unsigned w=1; w<workers; ++w) {
+            if (_pfPids[w] <= 0) continue;
+            if (waitpid(_pfPids[w], NULL, WNOHANG) == _pfPids[w]) {
+                _pfPids[w] = 0;
+                --running;
+            }
+        }
+        if (running && getElapsedTime() > _timeBudget + PORTFOLIO_GRACE) break;
+        if (running) usleep(PORTFOLIO_POLL_US);
+    }
+    for (unsigned w=1; w<workers; ++w) {
+        if (_pfPids[w] <= 0) continue;
+        kill(_pfPids[w], SIGKILL);
+        waitpid(_pfPids[w], NULL, 0);
+        _pfPids[w] = 0;
+    }
+
+    unsigned best = 0;
+    for (unsigned w=1; w<workers; ++w)
+        if (slots[w].bestWL < slots[best].bestWL) best = w;
+    for (unsigned w=0; w<workers; ++w) {
+        cout << "Worker " << w << " (" << pfName[w % PF_STRATEGY_TOT] << "): ";
+        if (slots[w].bestWL == UINT_MAX) cout << "no result\n";
+        else cout << "WL " << slots[w].bestWL << (slots[w].done ? "" : " (stopped)")
+                  << (w == best ? " <- best" : "") << "\n";
+    }
+
+    // Reload the winner so that the nets, the cells and the best state agree
+    if (best) {
+        if (readOutput(_pfFiles[best])) {
+            storeBestResult();
+            _bestTotalWL = evaluateWireLen();
+            _netRank->update();
+        }
+        else cerr << "Portfolio worker " << best << " failed to publish its result\n";
+    }
+
+    _pfSlots = 0;
+    _pfWorkers = 0;
+    for (unsigned w=1; w<workers; ++w) {
+        unlink(_pfFiles[w].c_str());
+        unlink(_pfTmpFiles[w].c_str());
+    }
+    munmap(map, mapSize);
+}
+
+// Called by a worker on every better result. The output goes to a
+// temporary file renamed over the worker's file before the WL reaches the
+// slot, so the file is never worse than the slot says. It costs about what
+// serializeBest() already spent on the same result.
+void
+RouteMgr::publishBest()
+{
+    if (!_pfSelf || _pfSlots[_pfSelf].bestWL <= _bestTotalWL) return;
+    const string& out = _bestOutput[_bestOutputIdx.load(memory_order_acquire)];
+    int fd = open(_pfTmpFiles[_pfSelf].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    bool ok = writeAll(fd, out.data(), out.size());
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(_pfTmpFiles[_pfSelf].c_str(), _pfFiles[_pfSelf].c_str()) == 0)
+        _pfSlots[_pfSelf].bestWL = _bestTotalWL;
+}
+
+// Copy the output of the worker with the best published WL if it beats
+// this process. Only open(2), read(2) and write(2), for dumpBest()
+bool
+RouteMgr::dumpWorkerBest(int fd) const
+{
+    unsigned best = 0, bestWL = _bestTotalWL;
+    for (unsigned w=1; w<_pfWorkers; ++w) {
+        unsigned wl = _pfSlots[w].bestWL.load(memory_order_acquire);
+        if (wl < bestWL) { best = w; bestWL = wl; }
+    }
+    if (!best) return false;
+    int in = open(_pfFiles[best].c_str(), O_RDONLY);
+    if (in < 0) return false;
+    bool ok = ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0;
+    char buf[1 << 12];
+    while (ok) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) { ok = n == 0; break; }
+        ok = writeAll(fd, buf, n);
+    }
+    close(in);
+    return ok;
+}
+
+// For the signal handler: stop the workers and remove their files
+void
+RouteMgr::abortPortfolio() const
+{
+    if (!_pfSlots) return;
+    for (unsigned w=1; w<_pfWorkers; ++w) {
+        if (_pfPids[w] > 0) kill(_pfPids[w], SIGKILL);
+        unlink(_pfFiles[w].c_str());
+        unlink(_pfTmpFiles[w].c_str());
+    }
+}
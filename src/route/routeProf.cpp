@@ -0,0 +1,105 @@
+/****************************************************************************
+  FileName     [ routeProf.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define profiling report ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include "routeProf.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+RouteProf routeProf;
+
+static const char* profTimerStr[PROF_TIMER_TOT] = {
+    "readCircuit.layers",
+    "readCircuit.supply",
+    "readCircuit.cells",
+    "readCircuit.routeDemand",
+    "readCircuit.blkgDemand",
+    "readCircuit.neighborDemand",
+    "readCircuit.netRank",
+    "route2Pin",
+    "layerassign",
+    "route3D",
+    "evaluateWireLen",
+    "storeBestResult",
+    "moveOneCell",
+    "precisePnR",
+    "reroute",
+    "annealPlace"
+};
+
+static const char* profCounterStr[PROF_COUNTER_TOT] = {
+    "route2Pin.expanded",
+    "route2Pin.failed",
+    "route2Pin.bidir",
+    "route2Pin.corridorHit",
+    "route2Pin.corridorMiss",
+    "reroute.skipped",
+    "routeCache.hit",
+    "routeCache.miss",
+    "routeCache.stale",
+    "layerassign.candidates",
+    "layerassign.overflowRejected",
+    "route3D.expanded",
+    "route3D.failed",
+    "precisePnR.accepted",
+    "precisePnR.rejected",
+    "annealPlace.moves",
+    "annealPlace.accepted",
+    "annealPlace.routed"
+};
+
+/**************************************/
+/*   class RouteProf member functions */
+/**************************************/
+void
+RouteProf::reset()
+{
+    for (unsigned i=0; i<PROF_TIMER_TOT; ++i) _calls[i] = _ns[i] = 0;
+    for (unsigned i=0; i<PROF_COUNTER_TOT; ++i) _counters[i] = 0;
+}
+
+void
+RouteProf::printReport(ostream& os) const
+{
+    if (!_enabled) {
+        os << "Profiling is disabled" << endl;
+        return;
+    }
+    os << setw(30) << left << "Scope" << setw(14) << right << "Calls"
+       << setw(14) << "Time(s)" << setw(14) << "Avg(us)" << "\n";
+    for (unsigned i=0; i<PROF_TIMER_TOT; ++i) {
+        if (!_calls[i]) continue;
+        os << setw(30) << left << profTimerStr[i] << setw(14) << right << _calls[i]
+           << setw(14) << fixed << setprecision(3) << _ns[i] / 1e9
+           << setw(14) << setprecision(2) << _ns[i] / 1e3 / _calls[i] << "\n";
+    }
+    os << "\n" << setw(30) << left << "Counter" << setw(14) << right << "Value" << "\n";
+    for (unsigned i=0; i<PROF_COUNTER_TOT; ++i)
+        os << setw(30) << left << profCounterStr[i] << setw(14) << right << _counters[i] << "\n";
+    os.unsetf(ios::floatfield);
+    os << setprecision(6);
+}
+
+void
+RouteProf::writeJson(ostream& os) const
+{
+    os << "{\n  \"timers\": {";
+    for (unsigned i=0; i<PROF_TIMER_TOT; ++i) {
+        os << (i ? ",\n" : "\n") << "    \"" << profTimerStr[i] << "\": { \"calls\": " << _calls[i]
+           << ", \"ns\": " << _ns[i] << " }";
+    }
+    os << "\n  },\n  \"counters\": {";
+    for (unsigned i=0; i<PROF_COUNTER_TOT; ++i) {
+        os << (i ? ",\n" : "\n") << "    \"" << profCounterStr[i] << "\": " << _counters[i];
+    }
+    os << "\n  }\n}\n";
+}
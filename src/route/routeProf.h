@@ -0,0 +1,123 @@
+/****************************************************************************
+  FileName     [ routeProf.h ]
+  PackageName  [ route ]
+  Synopsis     [ Define hot-path timers and counters ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef ROUTE_PROF_H
+#define ROUTE_PROF_H
+
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+//----------------------------------------------------------------------
+//    Profiled scopes and counters
+//----------------------------------------------------------------------
+enum ProfTimer
+{
+    PROF_READ_LAYERS,
+    PROF_READ_SUPPLY,
+    PROF_READ_CELLS,
+    PROF_READ_ROUTE_DEMAND,
+    PROF_READ_BLKG_DEMAND,
+    PROF_READ_NEIGHBOR_DEMAND,
+    PROF_READ_NET_RANK,
+    PROF_ROUTE2PIN,
+    PROF_LAYERASSIGN,
+    PROF_ROUTE3D,
+    PROF_EVAL_WL,
+    PROF_STORE_BEST,
+    PROF_MOVE_CELL,
+    PROF_PRECISE_PNR,
+    PROF_REROUTE,
+    PROF_ANNEAL,
+
+    // dummy
+    PROF_TIMER_TOT
+};
+
+enum ProfCounter
+{
+    PROF_ROUTE2PIN_EXPANDED,
+    PROF_ROUTE2PIN_FAIL,
+    PROF_ROUTE2PIN_BIDIR,
+    PROF_COARSE_HIT,
+    PROF_COARSE_MISS,
+    PROF_REROUTE_SKIP,
+    PROF_CACHE_HIT,
+    PROF_CACHE_MISS,
+    PROF_CACHE_STALE,
+    PROF_LA_CAND,
+    PROF_LA_OVERFLOW,
+    PROF_ROUTE3D_EXPANDED,
+    PROF_ROUTE3D_FAIL,
+    PROF_PRECISE_ACCEPT,
+    PROF_PRECISE_REJECT,
+    PROF_ANNEAL_MOVES,
+    PROF_ANNEAL_ACCEPT,
+    PROF_ANNEAL_COMMIT,
+
+    // dummy
+    PROF_COUNTER_TOT
+};
+
+//----------------------------------------------------------------------
+//    RouteProf
+//----------------------------------------------------------------------
+// Everything is guarded by a single flag, so a disabled profiler costs one
+// predictable branch per scope.
+class RouteProf
+{
+public:
+    RouteProf() : _enabled(false) { reset(); }
+
+    void enable(bool on = true) { _enabled = on; }
+    bool enabled() const { return _enabled; }
+    void reset();
+
+    void addTime(ProfTimer t, uint64_t ns) { ++_calls[t]; _ns[t] += ns; }
+    // For stages that do not map onto one C++ scope
+    void start(ProfTimer t) { if (_enabled) _start[t] = chrono::steady_clock::now(); }
+    void stop(ProfTimer t) {
+        if (_enabled) addTime(t, chrono::duration_cast<chrono::nanoseconds>(
+                                 chrono::steady_clock::now() - _start[t]).count());
+    }
+    void count(ProfCounter c, uint64_t n = 1) { if (_enabled) _counters[c] += n; }
+
+    void printReport(ostream& os = cout) const;
+    void writeJson(ostream& os) const;
+
+private:
+    bool        _enabled;
+    uint64_t    _calls[PROF_TIMER_TOT];
+    uint64_t    _ns[PROF_TIMER_TOT];
+    uint64_t    _counters[PROF_COUNTER_TOT];
+    chrono::steady_clock::time_point _start[PROF_TIMER_TOT];
+};
+
+extern RouteProf routeProf;
+
+class ProfScope
+{
+public:
+    ProfScope(ProfTimer t) : _timer(t), _on(routeProf.enabled()) {
+        if (_on) _start = chrono::steady_clock::now();
+    }
+    ~ProfScope() {
+        if (_on) routeProf.addTime(_timer, chrono::duration_cast<chrono::nanoseconds>(
+                                   chrono::steady_clock::now() - _start).count());
+    }
+private:
+    ProfTimer                           _timer;
+    bool                                _on;
+    chrono::steady_clock::time_point    _start;
+};
+
+#define PROF_SCOPE(t) ProfScope profScope_##t(t)
+
+#endif // ROUTE_PROF_H
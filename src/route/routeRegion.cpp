@@ -0,0 +1,214 @@
+/****************************************************************************
+  FileName     [ routeRegion.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define region partitioning and region-parallel reroute ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "routeMgr.h"
+#include "util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+#define REGION_HALO     2 // gGrids a net may detour beyond its bounding box
+#define REGION_PER_JOB  4 // regions per worker, so the load evens out
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+static bool
+writeAll(int fd, const vector<unsigned>& buf)
+{
+    const char* p = (const char*)buf.data();
+    size_t left = buf.size() * sizeof(unsigned);
+    while (left) {
+        ssize_t n = write(fd, p, left);
+        if (n <= 0) return false;
+        p += n; left -= n;
+    }
+    return true;
+}
+
+static void
+readAll(int fd, vector<unsigned>& buf)
+{
+    vector<char> bytes;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    buf.resize(bytes.size() / sizeof(unsigned));
+    copy(bytes.begin(), bytes.begin() + buf.size() * sizeof(unsigned), (char*)buf.data());
+}
+
+/*************************************/
+/*   class RouteMgr member functions */
+/*************************************/
+// Tile the gGrid into disjoint regions, about REGION_PER_JOB per worker.
+// A net belongs to a region if its pins and route, grown by REGION_HALO,
+// fit in it; otherwise it is a boundary net (UINT_MAX). Interior nets of
+// different regions never share a gGrid as long as each is routed inside
+// its region.
+void
+RouteMgr::partitionRegions(vector<GridRect>& regions, vector<unsigned>& netRegion) const
+{
+    unsigned rows = Ggrid::rEnd - Ggrid::rBeg + 1, cols = Ggrid::cEnd - Ggrid::cBeg + 1;
+    unsigned total = _jobs * REGION_PER_JOB;
+    unsigned tr = (unsigned)(sqrt((double)total * rows / cols) + 0.5);
+    tr = min(max(tr, 1u), rows);
+    unsigned tc = min(max(total / tr, 1u), cols);
+
+    vector<unsigned> rowTile(Ggrid::rEnd + 1), colTile(Ggrid::cEnd + 1);
+    regions.clear();
+    for (unsigned i=0; i<tr; ++i) {
+        unsigned rb = Ggrid::rBeg + i * rows / tr, re = Ggrid::rBeg + (i+1) * rows / tr - 1;
+        for (unsigned r=rb; r<=re; ++r) rowTile[r] = i;
+        for (unsigned j=0; j<tc; ++j) {
+            unsigned cb = Ggrid::cBeg + j * cols / tc, ce = Ggrid::cBeg + (j+1) * cols / tc - 1;
+            if (!i) for (unsigned c=cb; c<=ce; ++c) colTile[c] = j;
+            GridRect rect = { rb, cb, re, ce };
+            regions.push_back(rect);
+        }
+    }
+
+    netRegion.assign(_netList.size(), UINT_MAX);
+    for (unsigned i=0; i<_netList.size(); ++i) {
+        Net* n = _netList[i];
+        unsigned rLo = Ggrid::rEnd, rHi = Ggrid::rBeg, cLo = Ggrid::cEnd, cHi = Ggrid::cBeg;
+        for (auto& pin : n->_pinSet) {
+            Pos pos = getPinPos(pin);
+            rLo = min(rLo, pos.first);  rHi = max(rHi, pos.first);
+            cLo = min(cLo, pos.second); cHi = max(cHi, pos.second);
+        }
+        for (auto seg : n->_netSegs) {
+            rLo = min(rLo, min(seg->startPos[0], seg->endPos[0])); rHi = max(rHi, max(seg->startPos[0], seg->endPos[0]));
+            cLo = min(cLo, min(seg->startPos[1], seg->endPos[1])); cHi = max(cHi, max(seg->startPos[1], seg->endPos[1]));
+        }
+        if (rLo > rHi || cLo > cHi) continue;
+        rLo = (rLo > Ggrid::rBeg + REGION_HALO) ? rLo - REGION_HALO : Ggrid::rBeg;
+        cLo = (cLo > Ggrid::cBeg + REGION_HALO) ? cLo - REGION_HALO : Ggrid::cBeg;
+        rHi = min(rHi + REGION_HALO, Ggrid::rEnd);
+        cHi = min(cHi + REGION_HALO, Ggrid::cEnd);
+        if (rowTile[rLo] == rowTile[rHi] && colTile[cLo] == colTile[cHi])
+            netRegion[i] = rowTile[rLo] * tc + colTile[cLo];
+    }
+}
+
+// Reroute the interior nets of each region in forked workers, worker w
+// taking regions w, w+_jobs, ... A worker routes a net only inside its
+// region and pipes back, per net, the reroute(Net*) outcome and the new
+// route if it changed; the parent applies them with their demand. Nets
+// handled here are set in done, the rest are left to the serial pass.
+void
+RouteMgr::rerouteRegions(vector<bool>& done)
+{
+    vector<GridRect> regions;
+    vector<unsigned> netRegion;
+    partitionRegions(regions, netRegion);
+    #ifdef DEBUG
+    unsigned interior = 0;
+    for (auto r : netRegion) if (r != UINT_MAX) ++interior;
+    cout << regions.size() << " regions, " << interior << " interior nets of " << _netList.size() << "\n";
+    #endif
+
+    vector<pid_t> pids;
+    vector<int> fds;
+    cout.flush();
+    for (unsigned w=0; w<_jobs; ++w) {
+        int fd[2];
+        if (pipe(fd)) break;
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Leave the emergency output to the parent
+            signal(SIGINT, SIG_DFL);
+            signal(SIGSEGV, SIG_DFL);
+            close(fd[0]);
+            vector<unsigned> buf;
+            vector<Segment> origSegs;
+            for (unsigned i=0; i<_netList.size(); ++i) {
+                if (netRegion[i] == UINT_MAX || netRegion[i] % _jobs != w) continue;
+                if (timeUp()) break;
+                Net* n = _netList[i];
+                origSegs.clear();
+                for (auto s : n->_netSegs) origSegs.push_back(*s);
+                size_t targetCnt = _targetNetList.size();
+                _routeWin = regions[netRegion[i]];
+                reroute(n);
+                bool changed = (origSegs.size() != n->_netSegs.size());
+                for (unsigned k=0; k<origSegs.size() && !changed; ++k)
+                    changed = !equal(origSegs[k].startPos, origSegs[k].startPos + 3, n->_netSegs[k]->startPos) ||
+                              !equal(origSegs[k].endPos, origSegs[k].endPos + 3, n->_netSegs[k]->endPos);
+                buf.push_back(i);
+                buf.push_back((n->_routable ? 1 : 0) | (_targetNetList.size() > targetCnt ? 2 : 0));
+                buf.push_back((unsigned)n->_reducedLength);
+                buf.push_back(changed ? n->_netSegs.size() : UINT_MAX);
+                if (!changed) continue;
+                for (auto s : n->_netSegs) {
+                    buf.insert(buf.end(), s->startPos, s->startPos + 3);
+                    buf.insert(buf.end(), s->endPos, s->endPos + 3);
+                }
+            }
+            buf.push_back(UINT_MAX);
+            unsigned counters[6] = { _numOverflowNet1, _numOverflowNet2, _numOverflowNet3,
+                                     _numValidNet1, _numValidNet2, _numRouted3D };
+            buf.insert(buf.end(), counters, counters + 6);
+            _exit(writeAll(fd[1], buf) ? 0 : 1);
+        }
+        close(fd[1]);
+        if (pid < 0) { close(fd[0]); break; } // its regions go to the serial pass
+        pids.push_back(pid);
+        fds.push_back(fd[0]);
+    }
+
+    unsigned* counters[6] = { &_numOverflowNet1, &_numOverflowNet2, &_numOverflowNet3,
+                              &_numValidNet1, &_numValidNet2, &_numRouted3D };
+    unsigned base[6];
+    for (unsigned k=0; k<6; ++k) base[k] = *counters[k];
+    vector<unsigned> buf;
+    for (unsigned w=0; w<pids.size(); ++w) {
+        readAll(fds[w], buf);
+        close(fds[w]);
+        int status = 1;
+        waitpid(pids[w], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            cerr << "Region worker " << w << " failed, its nets are rerouted serially\n";
+            continue;
+        }
+        size_t p = 0;
+        while (p < buf.size() && buf[p] != UINT_MAX) {
+            Net* n = _netList[buf[p]];
+            done[buf[p]] = true;
+            unsigned flags = buf[p+1];
+            n->_reducedLength = (int)buf[p+2];
+            unsigned segCnt = buf[p+3];
+            p += 4;
+            if (segCnt != UINT_MAX) {
+                remove2DDemand(n);
+                remove3DDemand(n);
+                n->ripUp();
+                for (unsigned k=0; k<segCnt; ++k, p+=6)
+                    n->_netSegs.push_back(new Segment(buf[p], buf[p+1], buf[p+2], buf[p+3], buf[p+4], buf[p+5]));
+                add2DDemand(n);
+                add3DDemand(n);
+            }
+            n->shouldReroute(false);
+            n->_routable = flags & 1;
+            if (flags & 2) _targetNetList.push_back(n);
+        }
+        for (unsigned k=0; k<6 && p+1+k<buf.size(); ++k) *counters[k] += buf[p+1+k] - base[k];
+    }
+}
@@ -1,7 +1,11 @@
 #include <cassert>
 #include <algorithm>
+#include <queue>
+#include <cfloat>
+#include <climits>
 #include "routeRoute.h"
 #include "routeMgr.h"
+#include "routeProf.h"
 #include "util.h"
 
 // #define DEBUG
@@ -19,6 +23,55 @@ extern RouteMgr* routeMgr;
 /**************************************/
 /*   Static variables and functions   */
 /**************************************/
+const vector<Pos>* MapSearchNode::tree = 0;
+const vector<Pos>* MapSearchNode::sources = 0;
+
+#define TREE_SRC_SLACK 2 // tree gGrids this much farther than the closest one are also sources
+#define BIDIR_H_WEIGHT 10 // heuristic weight, the same as stlastar's
+#define COARSE_MIN_TILES 2 // connections at least this many tiles long are routed in a corridor
+
+#define LB_PAIR_PINS 16 // netLowerBound() walks every pin pair up to this many pins, else pairs with the first pin
+
+typedef pair<double,unsigned> BidirEntry; // (f, gGrid idx)
+
+static inline unsigned
+layDist(unsigned a, unsigned b)
+{
+    return a > b ? a - b : b - a;
+}
+
+// The layers of lays, sorted, worth running on for a walk over [lo, hi]:
+// the lowest one from lo up and the highest one below lo
+static unsigned
+layCands(const vector<unsigned>& lays, unsigned lo, unsigned cand[2])
+{
+    unsigned cnt = 0;
+    auto it = lower_bound(lays.begin(), lays.end(), lo);
+    if (it != lays.end()) cand[cnt++] = *it;
+    if (it != lays.begin()) cand[cnt++] = *(it-1);
+    return cnt;
+}
+
+// Fewest vias of a path from layer a to layer b that runs on a layer of
+// hLays if needH and on a layer of vLays if needV, UINT_MAX if none can
+static unsigned
+viaWalk(unsigned a, unsigned b, const vector<unsigned>& hLays, bool needH, const vector<unsigned>& vLays, bool needV)
+{
+    unsigned lo = min(a, b);
+    unsigned hCand[2], vCand[2];
+    unsigned hCnt = needH ? layCands(hLays, lo, hCand) : 1;
+    unsigned vCnt = needV ? layCands(vLays, lo, vCand) : 1;
+    if (!needH) hCand[0] = a;
+    if (!needV) vCand[0] = b;
+    unsigned best = UINT_MAX;
+    for (unsigned i=0; i<hCnt; ++i)
+        for (unsigned j=0; j<vCnt; ++j) {
+            unsigned x = hCand[i], y = vCand[j];
+            best = min(best, layDist(a, x) + layDist(x, y) + layDist(y, b));
+            best = min(best, layDist(a, y) + layDist(y, x) + layDist(x, b));
+        }
+    return best;
+}
 
 bool netCompare(Net* n1, Net* n2) // greater than , decsending order
 {
@@ -36,6 +89,7 @@ RouteMgr::route()
     #endif
     NetList targetNet = NetList();
     RouteExecStatus myStatus = ROUTE_EXEC_DONE;
+    buildCoarseGrid();
     //for (auto m : _netList){
     for (auto nPair : _netRank->NetWLpairs){
         Net* m = _netList[nPair.first-1];
@@ -47,17 +101,34 @@ RouteMgr::route()
             // cout << m->_netSegs.size() << " " << m->_netSegs.capacity() << endl;
         }
     }
+    vector<unsigned> pins;
     for (auto n : targetNet) {
-        if (route2D(n) == ROUTE_EXEC_ERROR) {
-            n->_routable = false;
-            myStatus = ROUTE_EXEC_ERROR;
-        } else {
-            if (layerassign(n) == ROUTE_EXEC_ERROR) {
-                n->_routable = false;
-                myStatus = ROUTE_EXEC_ERROR;
+        uint64_t key = 0;
+        if (_routeCache.capacity()) {
+            key = netPinKey(n, pins);
+            if (routeFromCache(n, key, pins)) continue;
+        }
+        bool assigned = (route2D(n) == ROUTE_EXEC_DONE); // layerassign() adds 3D demand
+        bool routed = assigned && layerassign(n) == ROUTE_EXEC_DONE && !(_route3D && n->checkOverflow());
+        if (!routed && _route3D) {
+            // The 2-stage route is put back with its demand if route3D()
+            // fails too, so the net is left as without _route3D
+            vector<Segment> segs;
+            for (auto s : n->_netSegs) segs.push_back(*s);
+            remove2DDemand(n);
+            if (assigned) remove3DDemand(n);
+            n->ripUp();
+            routed = (route3D(n) == ROUTE_EXEC_DONE);
+            if (routed) { ++_numRouted3D; n->shouldReroute(false); }
+            else {
+                for (auto& s : segs) n->_netSegs.push_back(new Segment(s));
+                add2DDemand(n);
+                if (assigned) add3DDemand(n);
             }
-            else n->_routable = true;
         }
+        n->_routable = routed;
+        if (!routed) myStatus = ROUTE_EXEC_ERROR;
+        else if (_routeCache.capacity()) cacheRoute(n, key, pins);
     }
     // sorted by #pins
     //sort( targetNet.begin(), targetNet.end(), netCompare);
@@ -75,6 +146,65 @@ RouteMgr::route()
     //return layerassign(targetNet);
 }
 
+// FNV-1a over the net ID and the (row, col, layer) of its pins, which are
+// also returned in pins
+uint64_t
+RouteMgr::netPinKey(const Net* n, vector<unsigned>& pins) const
+{
+    pins.clear();
+    for (auto& pin : n->_pinSet) {
+        Pos p = getPinPos(pin);
+        pins.push_back(p.first);
+        pins.push_back(p.second);
+        pins.push_back(getPinLay(pin));
+    }
+    uint64_t key = 14695981039346656037ULL;
+    key = (key ^ n->_netId) * 1099511628211ULL;
+    for (auto v : pins) key = (key ^ v) * 1099511628211ULL;
+    return key;
+}
+
+// Put back the cached route of the ripped-up n if its pins are where they
+// were and every layer it passes still has room for it. A stale entry is
+// dropped.
+bool
+RouteMgr::routeFromCache(Net* n, uint64_t key, const vector<unsigned>& pins)
+{
+    const RouteCacheEntry* e = _routeCache.find(key, n->_netId, pins);
+    if (!e) {
+        routeProf.count(PROF_CACHE_MISS);
+        return false;
+    }
+    for (auto& s : e->segs) n->_netSegs.push_back(new Segment(s));
+    set<Layer*> alpha;
+    passGrid(n, alpha);
+    assert(alpha.size() == e->wl);
+    for (auto lay : alpha) {
+        if (lay->getDemand() < (int)lay->getSupply()) continue;
+        n->ripUp();
+        _routeCache.erase(key);
+        routeProf.count(PROF_CACHE_STALE);
+        return false;
+    }
+    for (auto lay : alpha) lay->addDemand(1);
+    add2DDemand(n);
+    n->shouldReroute(false);
+    n->_routable = true;
+    routeProf.count(PROF_CACHE_HIT);
+    return true;
+}
+
+// Keep the route of n unless it overflows
+void
+RouteMgr::cacheRoute(Net* n, uint64_t key, const vector<unsigned>& pins)
+{
+    set<Layer*> alpha;
+    passGrid(n, alpha);
+    for (auto lay : alpha)
+        if (lay->isOverflow()) return;
+    _routeCache.insert(key, n->_netId, pins, n->_netSegs, alpha.size());
+}
+
 RouteExecStatus RouteMgr::route2D(Net* n)
 {
     // 1.   for each to-be routed net , sorted by #Pins
@@ -87,44 +217,72 @@ RouteExecStatus RouteMgr::route2D(Net* n)
     
     //auto pinSet = n->_pinSet;
     //cout << "Routing N" << n->_netId << endl;
-    unsigned availale_layer = _laySupply.size() - n->getMinLayCons() + 1;
-    double demand = ((double)_laySupply.size() / (double)availale_layer);
+    int64_t demand = net2DDemand(n);
     auto pinSet = n->sortPinSet();
-    for(auto it=pinSet.begin(); it != --pinSet.end();)
+    if (pinSet.empty()) { n->shouldReroute(false); return ROUTE_EXEC_DONE; }
+    // Each pin is routed to the whole partial tree, not only to the previous pin
+    vector<Pos> tree(1, getPinPos(*pinSet.begin()));
+    unsigned lay1 = getPinLay(*pinSet.begin());
+    for(auto it=++pinSet.begin(); it != pinSet.end(); ++it)
     {
-        Pos pos1 = getPinPos(*it);
-        Pos pos2 = getPinPos(*(++it));
-        unsigned lay1 = getPinLay(*(--it));
-        unsigned lay2 = getPinLay(*(++it));
-        if (!route2Pin(pos1, pos2, n, demand, lay1, lay2)) {
+        Pos pos2 = getPinPos(*it);
+        unsigned lay2 = getPinLay(*it);
+        if (!route2Pin(tree, pos2, n, demand, lay1, lay2)) {
             #ifdef DEBUG
             cout << "route2Pin("
-            << pos1.first << " " << pos1.second << ", " 
+            << tree.size() << " tree gGrids, "
             << pos2.first << " " << pos2.second
             << " ) failed!" << endl;
             #endif
             n->shouldReroute(true);
             return ROUTE_EXEC_ERROR;
         }
+        lay1 = 0; // later paths start on the tree, layerassign() picks the layer
     }
     n->shouldReroute(false);
     return ROUTE_EXEC_DONE;
 }
 RouteExecStatus RouteMgr::reroute()
 {
+    PROF_SCOPE(PROF_REROUTE);
     cout << "\nRerouting...\n";
     RouteExecStatus myStatus = ROUTE_EXEC_DONE;
-    _numOverflowNet1 = _numOverflowNet2 = _numOverflowNet3 = _numValidNet1 = _numValidNet2 = 0;
+    _numOverflowNet1 = _numOverflowNet2 = _numOverflowNet3 = _numValidNet1 = _numValidNet2 = _numRouted3D = 0;
+    _numAtBound = 0;
     _targetNetList.clear();
     _targetNetList.resize(0);
+    buildCoarseGrid();
+    // Nets that cannot get shorter keep their route
+    vector<bool> done(_netList.size(), false);
+    for (unsigned i=0; i<_netList.size(); ++i) {
+        Net* n = _netList[i];
+        if (!atLowerBound(n)) continue;
+        done[i] = true;
+        ++_numAtBound;
+        n->shouldReroute(false);
+        n->_reducedLength = 0;
+        _targetNetList.push_back(n);
+    }
+    routeProf.count(PROF_REROUTE_SKIP, _numAtBound);
+    cout << "Skip " << _numAtBound << " of " << _netList.size() << " nets at their lower bound\n";
+    // Interior nets of the regions in parallel, then the rest in order
+    if (_jobs > 1) {
+        rerouteRegions(done);
+        replaceBest();
+    }
     for (unsigned i=0; i<_netList.size(); ++i)
     {
+        if (done[i]) continue;
         /*if (reroute(_netList[i]) == ROUTE_EXEC_ERROR) {
             _netList[i]->_hasmovedbynb = true;
             for (auto cellPair : _netList[i]->_assoCellInstMap) {
                 routeMgr->_instList[cellPair.first-1]->_hasmovedbyfd = true;
             }
         }*/
+        if (timeUp()) {
+            cout << "Time limit reached, stop rerouting at net " << i+1 << "\n";
+            break;
+        }
         reroute(_netList[i]);
         if (i % 10000 == 0) {
             #ifdef DEBUG
@@ -136,6 +294,7 @@ RouteExecStatus RouteMgr::reroute()
     #ifdef DEBUG
     cout << "\nReroute done!\n";
     #endif
+    sort(_targetNetList.begin(), _targetNetList.end(), [](Net* a, Net* b) { return a->_netId < b->_netId; });
     replaceBest();
     _netRank->update();
     #ifdef DEBUG
@@ -148,12 +307,64 @@ RouteExecStatus RouteMgr::reroute()
          << "Cannot route       : " << _numOverflowNet1 << "\n" 
          << "Cannot layerassign : " << _numOverflowNet2 << "\n"
          << "Overflow           : " << _numOverflowNet3 << "\n"
+         << "Routed in 3D       : " << _numRouted3D << "\n"
          << "Valid but longer   : " << _numValidNet1 << "\n"
-         << "Valid and shorter  : " << _numValidNet2 << "\n\n";
+         << "Valid and shorter  : " << _numValidNet2 << "\n"
+         << "At lower bound     : " << _numAtBound << "\n\n";
     #endif
     return myStatus;
 }
 
+// No route of n passes fewer gGrids than its pins need. A tree of gGrids
+// has one more gGrid than edges: the H and V edges cover the pin bounding
+// box, and the vias cover the pin layers. The path between two pins also
+// climbs to an H (V) layer at _minLayCons or above if they differ in column
+// (row), so the vias are at least its fewest vias.
+unsigned
+RouteMgr::netLowerBound(const Net* n) const
+{
+    if (n->_pinSet.empty()) return 0;
+    vector<pair<Pos,unsigned>> pins; // (position, layer)
+    unsigned rMin = UINT_MAX, rMax = 0, cMin = UINT_MAX, cMax = 0, lMin = UINT_MAX, lMax = 0;
+    for (auto& pin : n->_pinSet) {
+        Pos p = getPinPos(pin);
+        unsigned l = getPinLay(pin);
+        pins.push_back(make_pair(p, l));
+        rMin = min(rMin, p.first);  rMax = max(rMax, p.first);
+        cMin = min(cMin, p.second); cMax = max(cMax, p.second);
+        lMin = min(lMin, l);        lMax = max(lMax, l);
+    }
+    vector<unsigned> hLays, vLays;
+    for (unsigned l=max(n->_minLayCons, 1u); l<=_layDir.size(); ++l)
+        (_layDir[l-1] ? hLays : vLays).push_back(l);
+
+    unsigned vias = lMax - lMin;
+    for (unsigned i=0; i<pins.size(); ++i) {
+        if (i && pins.size() > LB_PAIR_PINS) break;
+        for (unsigned j=i+1; j<pins.size(); ++j) {
+            unsigned walk = viaWalk(pins[i].second, pins[j].second,
+                                    hLays, pins[i].first.second != pins[j].first.second,
+                                    vLays, pins[i].first.first != pins[j].first.first);
+            if (walk != UINT_MAX) vias = max(vias, walk); // else no layer to route on
+        }
+    }
+    return (rMax - rMin) + (cMax - cMin) + vias + 1;
+}
+
+// Whether reroute() can leave n as it is: routed, without overflow and at
+// most _skipSlack gGrids above its lower bound
+bool
+RouteMgr::atLowerBound(Net* n) const
+{
+    if (!n->_routable || n->shouldReroute()) return false;
+    set<Layer*> alpha;
+    passGrid(n, alpha);
+    if (alpha.size() > netLowerBound(n) + _skipSlack) return false;
+    for (auto lay : alpha)
+        if (lay->isOverflow()) return false;
+    return true;
+}
+
 RouteExecStatus RouteMgr::reroute(Net* n)
 {
     RouteExecStatus myStatus = ROUTE_EXEC_DONE;
@@ -164,39 +375,31 @@ RouteExecStatus RouteMgr::reroute(Net* n)
     remove3DDemand(n);
     n->ripUp();
     n->shouldReroute(false);
+    bool routed = false;
     if (route2D(n) == ROUTE_EXEC_ERROR) {
         ++_numOverflowNet1;
         n->shouldReroute(false);
-        myStatus = ROUTE_EXEC_ERROR;
-        n->ripUp();
-        for (auto s : OOrigSegs) {
-            Segment* seg = new Segment(s);
-            n->_netSegs.push_back(seg);
-        }
-        add3DDemand(n);
-        n->_routable = false;
-        n->_reducedLength = 0;
-        return myStatus;
     }
-    if (layerassign(n) == ROUTE_EXEC_ERROR) {
+    else if (layerassign(n) == ROUTE_EXEC_ERROR) {
         ++_numOverflowNet2;
-        myStatus = ROUTE_EXEC_ERROR;
         remove3DDemand(n);
+    }
+    else if (n->checkOverflow()) {
+        ++_numOverflowNet3;
+        remove3DDemand(n);
+    }
+    else routed = true;
+    // Only the nets the 2-stage flow fails on are routed in 3D
+    if (!routed && _route3D) {
+        remove2DDemand(n); // of the partial 2-stage route
         n->ripUp();
-        for (auto s : OOrigSegs) {
-            Segment* seg = new Segment(s);
-            n->_netSegs.push_back(seg);
+        if (route3D(n) == ROUTE_EXEC_DONE) {
+            ++_numRouted3D;
+            routed = true;
         }
-        add3DDemand(n);
-        n->_routable = false;
-        n->_reducedLength = 0;
-        return myStatus;
     }
-    if (n->checkOverflow())
-    {
-        ++_numOverflowNet3;
+    if (!routed) {
         myStatus = ROUTE_EXEC_ERROR;
-        remove3DDemand(n);
         n->ripUp();
         for (auto s : OOrigSegs) {
             Segment* seg = new Segment(s);
@@ -233,123 +436,274 @@ RouteExecStatus RouteMgr::reroute(Net* n)
     return myStatus;
 }
 
-bool RouteMgr::route2Pin(Pos p1, Pos p2, Net* net, double demand, unsigned lay1, unsigned lay2)
+// Route a pin at p2 to the sorted gGrids of the partial net in tree, and
+// add the new gGrids to tree. lay1 is the layer of the path start when
+// tree is the first pin only, 0 when the path attaches to routed wires.
+bool RouteMgr::route2Pin(vector<Pos>& tree, Pos p2, Net* net, int64_t demand, unsigned lay1, unsigned lay2)
 {
-    AStarSearch<MapSearchNode> searchSolver;
-    MapSearchNode s = MapSearchNode(p1.first, p1.second); // start node
-    MapSearchNode t = MapSearchNode(p2.first, p2.second); // terminal node
-    searchSolver.SetStartAndGoalStates(s, t);
+    PROF_SCOPE(PROF_ROUTE2PIN);
+    // Start from the tree gGrids near the closest one to p2; the search is
+    // greedy, and stlastar scans its open list for every successor
+    unsigned minDist = UINT_MAX;
+    for (auto& p : tree)
+        minDist = min(minDist, (unsigned)(abs((int)p.first - (int)p2.first) + abs((int)p.second - (int)p2.second)));
+    vector<Pos> sources;
+    for (auto& p : tree)
+        if ((unsigned)(abs((int)p.first - (int)p2.first) + abs((int)p.second - (int)p2.second)) <= minDist + TREE_SRC_SLACK)
+            sources.push_back(p);
     #ifdef DEBUG
-    cout << "route2Pin from : " << p1.first << " " << p1.second << ", to "
-                                << p2.first << " " << p2.second << "." << endl;
+    cout << "route2Pin from " << tree.size() << " tree gGrids, to "
+                              << p2.first << " " << p2.second << "." << endl;
     #endif
-    unsigned searchState;
-    unsigned searchSteps = 0;
-    do{
-        searchState = searchSolver.SearchStep();
-        searchSteps++;
+
+    // Long connections are searched inside the corridor of a coarse route
+    // first, and on the whole grid if the corridor has no path
+    vector<Pos> path; // from a source to p2
+    bool corridor = _coarseTile && minDist >= COARSE_MIN_TILES * _coarseTile && setCorridor(sources, p2);
+    bool found = search2Pin(tree, sources, p2, minDist, path);
+    if (corridor) {
+        routeProf.count(found ? PROF_COARSE_HIT : PROF_COARSE_MISS);
+        _corridorOn = false;
+        if (!found) found = search2Pin(tree, sources, p2, minDist, path);
+    }
+    if (!found) {
+        cout << "Search terminated. Failed to find goal state" << endl;
+        routeProf.count(PROF_ROUTE2PIN_FAIL);
+        return false;
+    }
+
+    // One segment per straight run; the first one starts at lay1 and the
+    // last one ends at lay2
+    Pos node = path[0];
+    bool dir = 0;
+    if(path.size() > 1){
+        dir = (node.first - path[1].first)==0; // 1:col 0:row
+    }else{
+        Segment* news = new Segment(node.first, node.second, lay1,
+                                    node.first, node.second, lay2);
         #ifdef DEBUG
-            cout << "Step: " << searchSteps << endl;
-            int len = 0;
-            // open lists
-            cout << "Open:\n";
-            MapSearchNode* p = searchSolver.GetOpenListStart();
-            while(p){
-                len++;
-                p->PrintNodeInfo();
-                p = searchSolver.GetOpenListNext();
-            }
-            cout << "Open list has " << len <<  " nodes\n";
-            len = 0;
-
-            // closed list
-            cout << "Closed:\n";
-            p = searchSolver.GetClosedListStart();
-            while(p){
-                len++;
-                p->PrintNodeInfo();
-                p = searchSolver.GetClosedListNext();
-            }
-            cout << "Closed list has " << len << " nodes\n";
+        cout << "New Segment!! : " << node.first << " " << node.second << " " << lay1 << ", "
+                                   << node.first << " " << node.second << " " << lay2 << endl; 
         #endif
+        net->addSeg(news);
     }
-    while(searchState == AStarSearch<MapSearchNode>::SEARCH_STATE_SEARCHING);
-
-    if(searchState == AStarSearch<MapSearchNode>::SEARCH_STATE_SUCCEEDED){
-        // cout << "Search found goal state\n";
-        MapSearchNode* goal = searchSolver.GetSolutionEnd();
-        MapSearchNode* node =  searchSolver.GetSolutionStart(); 
-        MapSearchNode* next = searchSolver.GetSolutionNext();
-        bool dir = 0;
-        if(next){
-            dir = (node->x - next->x)==0; // 1:col 0:row
-        }else{
-            Segment* news = new Segment(node->x, node->y, lay1,
-                                        node->x, node->y, lay2);
+    Pos segStart = node;
+    #ifdef DEBUG
+    cout << "Net " << net->_netId << "\n";
+    #endif
+    if (lay1) (routeMgr->_gridList[node.first-1][node.second-1])->update2dDemandFixed(demand);
+    tree.push_back(node);
+
+    int dirCnt = 0;
+    for(unsigned i=1; i<path.size(); ++i){
+        Pos next = path[i];
+        if( dir != ((node.first-next.first)==0) ) { // changing direction
+            Segment* news = new Segment(segStart.first, segStart.second, dirCnt==0 ? lay1 : 0,
+                                        node.first    , node.second    , 0);
             #ifdef DEBUG
-            cout << "New Segment!! : " << node->x << " " << node->y << " " << lay1 << ", "
-                                       << node->x << " " << node->y << " " << lay2 << endl; 
+            cout << "New Segment!! : " << segStart.first << " " << segStart.second << " " << ( dirCnt==0 ? lay1 : 0 ) << " , "
+                                       << node.first     << " " << node.second     << " " << 0 << endl; 
             #endif
             net->addSeg(news);
-        }
-        Pos segStart = Pos(node->x, node->y);
-        #ifdef DEBUG
-        cout << "Net " << net->_netId << "\n";
-        #endif
-        (routeMgr->_gridList[node->x-1][node->y-1])->update2dDemand(demand);
-
-        int steps = 0;
-        int dirCnt = 0;
-        while(next){
-            if( dir != ((node->x-next->x)==0) ) { // changing direction
-                Segment* news = new Segment(segStart.first, segStart.second, dirCnt==0 ? lay1 : 0,
-                                            node->x       , node->y        , 0);
-                #ifdef DEBUG
-                cout << "New Segment!! : " << segStart.first << " " << segStart.second << " " << ( dirCnt==0 ? lay1 : 0 ) << " , "
-                                           << node->x        << " " << node->y         << " " << 0 << endl; 
-                #endif
-                net->addSeg(news);
-                segStart.first = node->x;
-                segStart.second = node->y;
-                dir = (node->x-next->x)==0 ;
-                dirCnt++;
-            } 
-            if( next==goal ){
-                Segment* news = new Segment(segStart.first, segStart.second, dirCnt==0 ? lay1 : 0,
-                                            next->x       , next->y        , lay2 );
-                #ifdef DEBUG
-                cout << "New Segment!! : " << segStart.first << " " << segStart.second << " " << (dirCnt==0 ? lay1 : 0) << " , "
-                                           << next->x        << " " << next->y         << " " << lay2 << endl; 
-                #endif
-                net->addSeg(news);                           
-            }
+            segStart = node;
+            dir = (node.first-next.first)==0 ;
+            dirCnt++;
+        } 
+        if( i+1 == path.size() ){
+            Segment* news = new Segment(segStart.first, segStart.second, dirCnt==0 ? lay1 : 0,
+                                        next.first    , next.second    , lay2 );
             #ifdef DEBUG
-            cout << "Net " << net->_netId << "\n";
+            cout << "New Segment!! : " << segStart.first << " " << segStart.second << " " << (dirCnt==0 ? lay1 : 0) << " , "
+                                       << next.first     << " " << next.second     << " " << lay2 << endl; 
             #endif
-            (routeMgr->_gridList[next->x-1][next->y-1])->update2dDemand(demand);
-            // node->PrintNodeInfo();
-            // next->PrintNodeInfo();
-            node = next;
-            next = searchSolver.GetSolutionNext();
-            steps++;
+            net->addSeg(news);                           
         }
-        // cout << "Solution steps " << steps << endl;
-        searchSolver.FreeSolutionNodes();
+        (routeMgr->_gridList[next.first-1][next.second-1])->update2dDemandFixed(demand);
+        tree.push_back(next);
+        node = next;
     }
-    else if(searchState == AStarSearch<MapSearchNode>::SEARCH_STATE_FAILED){
-        cout << "Search terminated. Failed to find goal state" << endl;
-        searchSolver.EnsureMemoryFreed();
-        return false;
+    sort(tree.begin(), tree.end());
+    tree.erase(unique(tree.begin(), tree.end()), tree.end());
+    return true;
+}
+
+// Path of gGrids from one of the sources to p2, by the stlastar search or,
+// for a long connection, the bidirectional one
+bool RouteMgr::search2Pin(const vector<Pos>& tree, const vector<Pos>& sources, Pos p2, unsigned minDist, vector<Pos>& path)
+{
+    path.clear();
+    if (_bidirMinDist && minDist >= _bidirMinDist) {
+        routeProf.count(PROF_ROUTE2PIN_BIDIR);
+        return route2PinBidir(tree, sources, p2, path);
     }
-    else{
-        cout << "Unexpected search states!!" << endl;
+    else {
+        AStarSearch<MapSearchNode> searchSolver;
+        MapSearchNode::tree = &tree;
+        MapSearchNode::sources = &sources;
+        MapSearchNode s = MapSearchNode(0, 0); // virtual start node before the tree
+        MapSearchNode t = MapSearchNode(p2.first, p2.second); // terminal node
+        searchSolver.SetStartAndGoalStates(s, t);
+        unsigned searchState;
+        unsigned searchSteps = 0;
+        do{
+            searchState = searchSolver.SearchStep();
+            searchSteps++;
+            #ifdef DEBUG
+                cout << "Step: " << searchSteps << endl;
+                int len = 0;
+                // open lists
+                cout << "Open:\n";
+                MapSearchNode* p = searchSolver.GetOpenListStart();
+                while(p){
+                    len++;
+                    p->PrintNodeInfo();
+                    p = searchSolver.GetOpenListNext();
+                }
+                cout << "Open list has " << len <<  " nodes\n";
+                len = 0;
+
+                // closed list
+                cout << "Closed:\n";
+                p = searchSolver.GetClosedListStart();
+                while(p){
+                    len++;
+                    p->PrintNodeInfo();
+                    p = searchSolver.GetClosedListNext();
+                }
+                cout << "Closed list has " << len << " nodes\n";
+            #endif
+        }
+        while(searchState == AStarSearch<MapSearchNode>::SEARCH_STATE_SEARCHING);
+        routeProf.count(PROF_ROUTE2PIN_EXPANDED, searchSteps);
+
+        if(searchState == AStarSearch<MapSearchNode>::SEARCH_STATE_SUCCEEDED){
+            // cout << "Search found goal state\n";
+            searchSolver.GetSolutionStart(); // the virtual start
+            for (MapSearchNode* node = searchSolver.GetSolutionNext(); node; node = searchSolver.GetSolutionNext())
+                path.push_back(Pos(node->x, node->y));
+            searchSolver.FreeSolutionNodes();
+        }
+        else if(searchState == AStarSearch<MapSearchNode>::SEARCH_STATE_FAILED){
+            searchSolver.EnsureMemoryFreed();
+            return false;
+        }
+        else{
+            cout << "Unexpected search states!!" << endl;
+            searchSolver.EnsureMemoryFreed();
+            return false;
+        }
+
+        //cout << "SearchSteps : " << searchSteps << endl;
+
         searchSolver.EnsureMemoryFreed();
-        return false;
     }
+    return true;
+}
 
-    //cout << "SearchSteps : " << searchSteps << endl;
+// Bidirectional version of the stlastar search of route2Pin(), on flat
+// arrays: one search grows from the sources towards p2, the other from p2
+// towards the source closest to it, with the same step costs (the -2D
+// congestion of the gGrid left) and the same weighted Manhattan heuristic.
+// The side with the smaller open list is expanded next, and the search
+// stops when one side expands a gGrid the other side has expanded; the
+// path goes through that gGrid. Costs are negative, so the cheapest
+// meeting point would favor detours; it is only used if one side runs
+// out of gGrids first. path gets the gGrids from a source to p2.
+bool
+RouteMgr::route2PinBidir(const vector<Pos>& tree, const vector<Pos>& sources, Pos p2, vector<Pos>& path)
+{
+    const unsigned cEnd = Ggrid::cEnd;
+    const unsigned gridCnt = Ggrid::rEnd * cEnd;
+    if (_bidirSeen[0].size() != gridCnt) {
+        for (unsigned d=0; d<2; ++d) {
+            _bidirG[d].assign(gridCnt, 0);
+            _bidirPrev[d].assign(gridCnt, 0);
+            _bidirSeen[d].assign(gridCnt, 0);
+            _bidirDone[d].assign(gridCnt, 0);
+        }
+        _bidirRun = 0;
+    }
+    if (++_bidirRun == 0) { // stamps wrapped around
+        for (unsigned d=0; d<2; ++d) {
+            fill(_bidirSeen[d].begin(), _bidirSeen[d].end(), 0);
+            fill(_bidirDone[d].begin(), _bidirDone[d].end(), 0);
+        }
+        _bidirRun = 1;
+    }
+    const unsigned run = _bidirRun;
+
+    Pos goal[2] = { p2, sources[0] }; // forward: p2, backward: the closest source
+    for (auto& p : sources)
+        if (abs((int)p.first - (int)p2.first) + abs((int)p.second - (int)p2.second) <
+            abs((int)goal[1].first - (int)p2.first) + abs((int)goal[1].second - (int)p2.second))
+            goal[1] = p;
+    auto heuristic = [&goal](unsigned d, unsigned r, unsigned c) {
+        return (double)BIDIR_H_WEIGHT * (abs((int)r - (int)goal[d].first) + abs((int)c - (int)goal[d].second));
+    };
+
+    priority_queue<BidirEntry, vector<BidirEntry>, greater<BidirEntry>> open[2];
+    for (auto& p : sources) {
+        unsigned s = (p.first-1) * cEnd + (p.second-1);
+        _bidirSeen[0][s] = run;
+        _bidirG[0][s] = 0;
+        _bidirPrev[0][s] = s;
+        open[0].push(BidirEntry(heuristic(0, p.first, p.second), s));
+    }
+    const unsigned target = (p2.first-1) * cEnd + (p2.second-1);
+    _bidirSeen[1][target] = run;
+    _bidirG[1][target] = 0;
+    _bidirPrev[1][target] = target;
+    open[1].push(BidirEntry(heuristic(1, p2.first, p2.second), target));
 
-    searchSolver.EnsureMemoryFreed();
+    double bestCost = DBL_MAX;
+    unsigned meet = UINT_MAX;
+    unsigned expanded = 0;
+    while (!open[0].empty() && !open[1].empty()) {
+        unsigned d = (open[0].size() <= open[1].size()) ? 0 : 1;
+        unsigned u = open[d].top().second;
+        open[d].pop();
+        if (_bidirDone[d][u] == run) continue; // stale
+        _bidirDone[d][u] = run;
+        ++expanded;
+        if (_bidirDone[d^1][u] == run) { meet = u; break; } // the searches met
+
+        unsigned r = u / cEnd + 1, c = u % cEnd + 1;
+        double costU = getCongestion(Pos(r, c));
+        const int dr[4] = { -1, 0, 1, 0 }, dc[4] = { 0, -1, 0, 1 };
+        for (unsigned k=0; k<4; ++k) {
+            unsigned nr = r + dr[k], nc = c + dc[k];
+            if (nr < Ggrid::rBeg || nr > Ggrid::rEnd || nc < Ggrid::cBeg || nc > Ggrid::cEnd) continue;
+            if (!inRouteWindow(nr, nc)) continue;
+            unsigned v = (nr-1) * cEnd + (nc-1);
+            if (_bidirDone[d][v] == run) continue; // steps cost < 0, so never reopen
+            bool isSource = _bidirSeen[0][v] == run && _bidirPrev[0][v] == v;
+            if (!(d == 1 && isSource) && binary_search(tree.begin(), tree.end(), Pos(nr, nc))) continue;
+            // A step costs the congestion of the gGrid it leaves
+            double g = _bidirG[d][u] + (d == 0 ? costU : getCongestion(Pos(nr, nc)));
+            if (_bidirSeen[d][v] == run && _bidirG[d][v] <= g) continue;
+            _bidirSeen[d][v] = run;
+            _bidirG[d][v] = g;
+            _bidirPrev[d][v] = u;
+            open[d].push(BidirEntry(g + heuristic(d, nr, nc), v));
+            if (_bidirSeen[d^1][v] == run && g + _bidirG[d^1][v] < bestCost) { // in case a side runs dry
+                bestCost = g + _bidirG[d^1][v];
+                meet = v;
+            }
+        }
+    }
+    routeProf.count(PROF_ROUTE2PIN_EXPANDED, expanded);
+    if (meet == UINT_MAX) return false;
+
+    path.clear();
+    for (unsigned v=meet; ; v=_bidirPrev[0][v]) {
+        path.push_back(Pos(v / cEnd + 1, v % cEnd + 1));
+        if (_bidirPrev[0][v] == v) break;
+    }
+    reverse(path.begin(), path.end());
+    for (unsigned v=meet; v!=target; ) {
+        v = _bidirPrev[1][v];
+        path.push_back(Pos(v / cEnd + 1, v % cEnd + 1));
+    }
     return true;
 }
 
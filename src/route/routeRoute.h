@@ -19,9 +19,21 @@ public:
 	MapSearchNode() { x = y = 0; }
 	MapSearchNode( int px, int py ) { x=px; y=py; }
 
+    // Sorted gGrids already on the net, never entered again. The node (0, 0)
+    // is a virtual source whose successors are the sources, so one search
+    // starts from the tree.
+    static const vector<Pos>* tree;
+    static const vector<Pos>* sources;
+
+    bool OnTree( int px, int py )
+    {
+        return tree && binary_search(tree->begin(), tree->end(), Pos(px, py));
+    }
+
     // Heuristic function that estimate the distance to Goal
 	float GoalDistanceEstimate( MapSearchNode &nodeGoal )
     {
+        if (x == 0) return 0;
         return abs(x-nodeGoal.x) + abs(y-nodeGoal.y);
     }
 
@@ -33,6 +45,7 @@ public:
     double GetMap(int x, int y){
         if (x <= 0) return INT32_MAX;
         if (y <= 0) return INT32_MAX;
+        if (!routeMgr->inRouteWindow(x, y)) return INT32_MAX;
         return routeMgr->getCongestion(Pos(x, y));
     }
 
@@ -51,29 +64,37 @@ public:
 
         MapSearchNode newNode;
 
+        if (x == 0) {
+            for (auto& p : *sources) {
+                newNode = MapSearchNode( p.first, p.second );
+                astarsearch->AddSuccessor( newNode );
+            }
+            return true;
+        }
+
         // push each possible node 
-        if( (GetMap( x-1, y ) < -CONGEST_MIN) && 
+        if( (GetMap( x-1, y ) < -CONGEST_MIN) && !OnTree( x-1, y ) &&
             !((parentX == x-1) && (parentY == y)) ) 
 	    {
 		    newNode = MapSearchNode( x-1, y );
 		    astarsearch->AddSuccessor( newNode );
 	    }
 
-        if( (GetMap( x, y-1 ) < -CONGEST_MIN) && 
+        if( (GetMap( x, y-1 ) < -CONGEST_MIN) && !OnTree( x, y-1 ) &&
             !((parentX == x) && (parentY == y-1)) ) 
 	    {
 		    newNode = MapSearchNode( x, y-1 );
 		    astarsearch->AddSuccessor( newNode );
 	    }
 
-        if( (GetMap( x+1, y ) < -CONGEST_MIN) && 
+        if( (GetMap( x+1, y ) < -CONGEST_MIN) && !OnTree( x+1, y ) &&
             !((parentX == x+1) && (parentY == y)) ) 
 	    {
 		    newNode = MapSearchNode( x+1, y );
 		    astarsearch->AddSuccessor( newNode );
 	    }
 
-        if( (GetMap( x, y+1 ) < -CONGEST_MIN) && 
+        if( (GetMap( x, y+1 ) < -CONGEST_MIN) && !OnTree( x, y+1 ) &&
             !((parentX == x) && (parentY == y+1)) ) 
 	    {
 		    newNode = MapSearchNode( x, y+1 );
@@ -84,6 +105,7 @@ public:
 
 	double GetCost( MapSearchNode &successor )
     {
+        if (x == 0) return 0;
         return routeMgr->getCongestion(Pos(x, y));
     }
 
@@ -0,0 +1,274 @@
+/****************************************************************************
+  FileName     [ routeVerify.cpp ]
+  PackageName  [ route ]
+  Synopsis     [ Define in-process solution verifier ]
+  Author       [ Chien-Kai Ma, Kai-Chun Chang, Yu-Wei Fan ]
+  Copyright    [ Copyleft(c) 2020-present NTU, Taiwan ]
+****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include "routeMgr.h"
+#include "util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+extern RouteMgr* routeMgr;
+
+/**************************************/
+/*   Static variables and functions   */
+/**************************************/
+// Index of a 3D gGrid, same order as RouteMgr::_layerPool
+static inline size_t
+gridKey(unsigned row, unsigned col, unsigned lay, unsigned layCnt)
+{
+    return ((size_t)(row-1) * Ggrid::cEnd + (col-1)) * layCnt + (lay-1);
+}
+
+static unsigned
+findRoot(vector<unsigned>& parent, unsigned x)
+{
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+static inline unsigned
+nodeIdx(const vector<size_t>& nodes, size_t key)
+{
+    return lower_bound(nodes.begin(), nodes.end(), key) - nodes.begin();
+}
+
+/*************************************/
+/*   class RouteMgr member functions */
+/*************************************/
+// Check the current placement and routes against the contest rules:
+// moved-cell limit, fixed cells, segment legality, layer direction, min
+// routing layer, pin connectivity of every net and gGrid overflow.
+// Every violation is reported with an [Error!] line. Like the contest
+// evaluator, the gGrid length of a net is the number of gGrids covered by
+// its segments and pins, which equals evaluateWireLen() once it is connected.
+bool
+RouteMgr::verify(unsigned* wireLen) const
+{
+    unsigned layCnt = _laySupply.size();
+    unsigned errCnt = 0;
+
+    // Cells
+    unsigned movedCnt = 0;
+    for (auto cell : _instList) {
+        if (cell->getPos() == cell->getInitPos()) continue;
+        ++movedCnt;
+        if (!cell->is_movable()) {
+            cout << "[Error!] Fixed CellInst C" << cell->getId() << " is moved\n";
+            ++errCnt;
+        }
+    }
+    if (movedCnt > _maxMoveCnt) {
+        cout << "[Error!] " << movedCnt << " cells are moved, MaxCellMove is " << _maxMoveCnt << "\n";
+        ++errCnt;
+    }
+
+    // Nets
+    unsigned totalWL = 0;
+    vector<size_t> nodes;
+    vector<pair<size_t,size_t>> edges;
+    vector<unsigned> parent;
+    for (auto n : _netList) {
+        nodes.clear(); edges.clear();
+        for (auto seg : n->_netSegs) {
+            const unsigned* s = seg->startPos;
+            const unsigned* e = seg->endPos;
+            if (!seg->isValid()) {
+                cout << "[Error!] Net N" << n->_netId << " has a segment out of boundary\n";
+                ++errCnt;
+                continue;
+            }
+            unsigned axis = 3, diffCnt = 0;
+            for (unsigned d=0; d<3; ++d)
+                if (s[d] != e[d]) { axis = d; ++diffCnt; }
+            if (diffCnt > 1) {
+                cout << "[Error!] Net N" << n->_netId << " has a non-rectilinear segment\n";
+                ++errCnt;
+                continue;
+            }
+            if (axis < 2) {
+                bool horizontal = (axis == 1); // H: same row, column changes
+                if (_layDir[s[2]-1] != horizontal) {
+                    cout << "[Error!] Net N" << n->_netId << " routes " << (horizontal ? "H" : "V")
+                         << " on layer M" << s[2] << "\n";
+                    ++errCnt;
+                }
+                if (s[2] < n->getMinLayCons()) {
+                    cout << "[Error!] Net N" << n->_netId << " routes on layer M" << s[2]
+                         << " below its min layer M" << n->getMinLayCons() << "\n";
+                    ++errCnt;
+                }
+            }
+            unsigned p[3] = { s[0], s[1], s[2] };
+            size_t prev = gridKey(p[0], p[1], p[2], layCnt);
+            nodes.push_back(prev);
+            if (axis == 3) continue;
+            while (p[axis] != e[axis]) {
+                p[axis] += (p[axis] < e[axis]) ? 1 : -1;
+                size_t cur = gridKey(p[0], p[1], p[2], layCnt);
+                nodes.push_back(cur);
+                edges.push_back(make_pair(prev, cur));
+                prev = cur;
+            }
+        }
+
+        // Union-find over the gGrids of the segments and pins
+        for (auto& pin : n->_pinSet) {
+            Pos pos = getPinPos(pin);
+            nodes.push_back(gridKey(pos.first, pos.second, getPinLay(pin), layCnt));
+        }
+        sort(nodes.begin(), nodes.end());
+        nodes.erase(unique(nodes.begin(), nodes.end()), nodes.end());
+        totalWL += nodes.size();
+        parent.resize(nodes.size());
+        for (unsigned i=0; i<parent.size(); ++i) parent[i] = i;
+        for (auto& edge : edges) {
+            unsigned a = findRoot(parent, nodeIdx(nodes, edge.first));
+            unsigned b = findRoot(parent, nodeIdx(nodes, edge.second));
+            if (a != b) parent[a] = b;
+        }
+        bool first = true;
+        unsigned root = 0;
+        for (auto& pin : n->_pinSet) {
+            Pos pos = getPinPos(pin);
+            unsigned r = findRoot(parent, nodeIdx(nodes, gridKey(pos.first, pos.second, getPinLay(pin), layCnt)));
+            if (first) { root = r; first = false; }
+            else if (r != root) {
+                cout << "[Error!] Net N" << n->_netId << " is open at pin C" << pin.first
+                     << "/P" << pin.second << "\n";
+                ++errCnt;
+                break;
+            }
+        }
+    }
+
+    // Overflow
+    for (unsigned i=Ggrid::rBeg; i<=Ggrid::rEnd; ++i) {
+        for (unsigned j=Ggrid::cBeg; j<=Ggrid::cEnd; ++j) {
+            for (unsigned k=1; k<=layCnt; ++k) {
+                const Layer& lay = _layerPool[gridKey(i, j, k, layCnt)];
+                if (lay.getDemand() > (int)lay.getSupply()) {
+                    cout << "[Error!] gGrid(" << i << ", " << j << ", " << k << ") overflows, supply "
+                         << lay.getSupply() << " demand " << lay.getDemand() << "\n";
+                    ++errCnt;
+                }
+            }
+        }
+    }
+
+    if (wireLen) *wireLen = totalWL;
+    return errCnt == 0;
+}
+
+// Move a cell with all of its blockage and neighbor demand
+void
+RouteMgr::relocateCell(CellInst* cell, Pos pos)
+{
+    remove2DBlkDemand(cell);
+    remove3DBlkDemand(cell);
+    vector<CellInst*>& oldList = cell->getGrid()->cellInstList;
+    for (unsigned j=0; j<oldList.size(); ++j) {
+        if (oldList[j] == cell) { oldList.erase(oldList.begin() + j); break; }
+    }
+    removeSameGgridDemand(cell);
+    removeAdjHGgridDemand(cell);
+    cell->move(pos);
+    add2DBlkDemand(cell);
+    add3DBlkDemand(cell);
+    addSameGgridDemand(cell);
+    addAdjHGgridDemand(cell);
+    cell->getGrid()->cellInstList.push_back(cell);
+    if (pos != cell->getInitPos()) _curMovedSet.insert(cell);
+    else _curMovedSet.erase(cell);
+}
+
+// Load a solution file in place of the current cells and routes, so that
+// verify() judges it. Only malformed lines are rejected here.
+bool
+RouteMgr::readOutput(const string& fileName)
+{
+    ifstream ifs(fileName.c_str());
+    if (!ifs) {
+        cerr << "Error: \"" << fileName << "\" does not exist!!" << endl;
+        return false;
+    }
+    string buffer;
+    unsigned cnt = 0, r, c;
+    int id;
+
+    ifs >> buffer >> cnt; // NumMovedCellInst
+    if (!ifs || buffer != "NumMovedCellInst") {
+        cout << "[Error!] Missing NumMovedCellInst\n";
+        return false;
+    }
+    cout << "NumMovedCellInst " << cnt << "\n";
+    vector<pair<CellInst*,Pos>> moves(cnt);
+    for (unsigned i=0; i<cnt; ++i) {
+        ifs >> buffer; // CellInst
+        ifs >> buffer; // instName
+        ifs >> r >> c;
+        if (!ifs || buffer.size() < 2 || !myStr2Int(buffer.substr(1), id) ||
+            id < 1 || id > (int)_instList.size() ||
+            r < Ggrid::rBeg || r > Ggrid::rEnd || c < Ggrid::cBeg || c > Ggrid::cEnd) {
+            cout << "[Error!] Illegal moved CellInst #" << i+1 << "\n";
+            return false;
+        }
+        moves[i] = make_pair(_instList[id-1], Pos(r, c));
+    }
+
+    ifs >> buffer >> cnt; // NumRoutes
+    if (!ifs || buffer != "NumRoutes") {
+        cout << "[Error!] Missing NumRoutes\n";
+        return false;
+    }
+    cout << "NumRoutes " << cnt << "\n";
+    vector<vector<Segment>> netSegs(_netList.size());
+    for (unsigned i=0; i<cnt; ++i) {
+        Segment seg;
+        for (unsigned j=0; j<3; ++j) ifs >> seg.startPos[j];
+        for (unsigned j=0; j<3; ++j) ifs >> seg.endPos[j];
+        ifs >> buffer; // netName
+        if (!ifs || buffer.size() < 2 || !myStr2Int(buffer.substr(1), id) ||
+            id < 1 || id > (int)_netList.size() || !seg.isValid() ||
+            (seg.startPos[0] != seg.endPos[0]) + (seg.startPos[1] != seg.endPos[1]) +
+            (seg.startPos[2] != seg.endPos[2]) > 1) {
+            cout << "[Error!] Illegal route segment #" << i+1 << "\n";
+            return false;
+        }
+        netSegs[id-1].push_back(seg);
+    }
+
+    // Rip up with the old pin positions, then move cells and put routes back
+    for (auto n : _netList) {
+        remove2DDemand(n);
+        remove3DDemand(n);
+        n->ripUp();
+    }
+    vector<CellInst*> moved(_curMovedSet.begin(), _curMovedSet.end());
+    for (auto cell : moved)
+        relocateCell(cell, cell->getInitPos());
+    for (auto& m : moves)
+        relocateCell(m.first, m.second);
+    for (unsigned i=0; i<_netList.size(); ++i) {
+        Net* n = _netList[i];
+        for (auto& s : netSegs[i])
+            n->_netSegs.push_back(new Segment(s.startPos[0], s.startPos[1], s.startPos[2],
+                                              s.endPos[0], s.endPos[1], s.endPos[2]));
+        add2DDemand(n);
+        add3DDemand(n);
+    }
+    return true;
+}
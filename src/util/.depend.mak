@@ -1,3 +1,3 @@
-myString.o: myString.cpp
 myGetChar.o: myGetChar.cpp
+myString.o: myString.cpp
 util.o: util.cpp rnGen.h myUsage.h
@@ -12,19 +12,72 @@
 #include <sys/types.h>
 #include <stdlib.h>  
 #include <limits.h>
+#include <stdint.h>
 
-#define my_srandom  srandom
-#define my_random   random
-
+// xoshiro256** (Blackman & Vigna). main seeds the global rnGen with
+// reset(--seed); portfolio worker w is a fork()ed copy that calls jump()
+// w times, so every worker draws its own reproducible stream.
 class RandomNumGen
 {
    public:
-      RandomNumGen() { my_srandom(getpid()); }
-      RandomNumGen(unsigned seed) { my_srandom(seed); }
-      const int operator() (const int range) const {
-         return int(range * (double(my_random()) / INT_MAX));
+      RandomNumGen(uint64_t seed = 0) { reset(seed); }
+
+      // Seed the state through splitmix64; stream i is i jumps (2^128 draws)
+      // ahead, so streams of one seed never overlap
+      void reset(uint64_t seed, unsigned stream = 0) {
+         for (unsigned i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            _s[i] = z ^ (z >> 31);
+         }
+         for (unsigned i = 0; i < stream; ++i) jump();
+      }
+
+      uint64_t next() {
+         uint64_t result = rotl(_s[1] * 5, 7) * 9;
+         uint64_t t = _s[1] << 17;
+         _s[2] ^= _s[0]; _s[3] ^= _s[1];
+         _s[1] ^= _s[2]; _s[0] ^= _s[3];
+         _s[2] ^= t;
+         _s[3] = rotl(_s[3], 45);
+         return result;
+      }
+
+      // Unbiased integer in [0, range) by Lemire's multiply-and-reject
+      int operator() (const int range) {
+         if (range <= 0) return 0;
+         uint32_t r = (uint32_t)range;
+         uint64_t m = (next() >> 32) * r;
+         uint32_t low = (uint32_t)m;
+         if (low < r) {
+            uint32_t thresh = (0u - r) % r;
+            while (low < thresh) {
+               m = (next() >> 32) * r;
+               low = (uint32_t)m;
+            }
+         }
+         return int(m >> 32);
       }
+
+      void jump() {
+         static const uint64_t JUMP[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                           0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+         uint64_t s[4] = { 0, 0, 0, 0 };
+         for (unsigned i = 0; i < 4; ++i)
+            for (unsigned b = 0; b < 64; ++b) {
+               if (JUMP[i] & (1ULL << b))
+                  for (unsigned j = 0; j < 4; ++j) s[j] ^= _s[j];
+               next();
+            }
+         for (unsigned j = 0; j < 4; ++j) _s[j] = s[j];
+      }
+
+   private:
+      uint64_t _s[4];
+
+      static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
 };
 
 #endif // RN_GEN_H
-
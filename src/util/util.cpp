@@ -23,7 +23,7 @@ using namespace std;
 //    Global variables in util
 //----------------------------------------------------------------------
 
-RandomNumGen  rnGen(0);  // use random seed = 0
+thread_local RandomNumGen  rnGen(0);  // use random seed = 0, reseeded by --seed
 MyUsage       myUsage;
 
 
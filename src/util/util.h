@@ -16,7 +16,7 @@
 using namespace std;
 
 // Extern global variable defined in util.cpp
-extern RandomNumGen  rnGen;
+extern thread_local RandomNumGen  rnGen;
 extern MyUsage       myUsage;
 
 // In myString.cpp